@@ -0,0 +1,130 @@
+#ifndef ASSET_REGISTRY_H
+#define ASSET_REGISTRY_H
+
+#include <learnopengl/mesh_cache.h>
+
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Process wide registry of loaded assets. Everything is keyed by canonical path plus content hash, so the same
+// file requested twice (e.g. both eyeballs) is imported, uploaded and kept in memory only once, while an edited
+// file gets a new key. The registry only holds weak references: an asset lives as long as somebody uses it.
+class AssetRegistry
+{
+public:
+    static AssetRegistry &Instance()
+    {
+        static AssetRegistry registry;
+        return registry;
+    }
+
+    // canonical path + content hash of a file, e.g. "/abs/path/eyeball.obj#1f2e..."; empty if the file can't be read
+    static std::string FileKey(const std::string &path, uint64_t contentHash)
+    {
+        char resolved[PATH_MAX];
+        std::string canonical = realpath(path.c_str(), resolved) ? resolved : path;
+        char hash[17];
+        snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)contentHash);
+        return canonical + '#' + hash;
+    }
+
+    static std::string FileKey(const std::string &path)
+    {
+        MappedFile file(path);
+        if (!file.isOpen())
+            return std::string();
+        return FileKey(path, HashWords(file.data, file.size));
+    }
+
+    // returns the live asset stored under 'key' or creates it with 'create' and remembers it.
+    // the kind of asset is part of the key, so different asset types never collide.
+    template<typename T>
+    std::shared_ptr<T> Acquire(const std::string &kind, const std::string &key, const std::function<std::shared_ptr<T>()> &create)
+    {
+        std::string fullKey = kind + ':' + key;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = assets.find(fullKey);
+            if (it != assets.end())
+            {
+                if (std::shared_ptr<void> live = it->second.lock())
+                    return std::static_pointer_cast<T>(live);
+            }
+        }
+        std::shared_ptr<T> asset = create();
+        std::lock_guard<std::mutex> lock(mutex);
+        assets[fullKey] = asset;
+        return asset;
+    }
+
+    // like Acquire, but for expensive CPU side work that may run concurrently on several worker threads:
+    // the first caller for a key runs 'create', later callers for the same key wait for its result. if 'create'
+    // throws, every waiting caller rethrows the exception.
+    template<typename T>
+    std::shared_ptr<const T> AcquireOnce(const std::string &kind, const std::string &key, const std::function<T()> &create)
+    {
+        std::string fullKey = kind + ':' + key;
+        std::shared_ptr<std::promise<std::shared_ptr<void>>> started;
+        std::shared_future<std::shared_ptr<void>> pending;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = assets.find(fullKey);
+            if (it != assets.end())
+            {
+                if (std::shared_ptr<void> live = it->second.lock())
+                    return std::static_pointer_cast<const T>(live);
+            }
+            auto running = inFlight.find(fullKey);
+            if (running != inFlight.end())
+                pending = running->second;
+            else
+            {
+                started = std::make_shared<std::promise<std::shared_ptr<void>>>();
+                inFlight[fullKey] = started->get_future().share();
+            }
+        }
+        if (!started)
+            return std::static_pointer_cast<const T>(pending.get());
+
+        std::shared_ptr<T> result;
+        try
+        {
+            result = std::make_shared<T>(create());
+        }
+        catch (...)
+        {
+            // the waiting callers get the same exception, a later call starts over
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                inFlight.erase(fullKey);
+            }
+            started->set_exception(std::current_exception());
+            throw;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            assets[fullKey] = result;
+            inFlight.erase(fullKey);
+        }
+        started->set_value(result);
+        return result;
+    }
+
+private:
+    AssetRegistry() {}
+
+    std::mutex mutex;
+    std::unordered_map<std::string, std::weak_ptr<void>> assets;
+    std::unordered_map<std::string, std::shared_future<std::shared_ptr<void>>> inFlight;
+};
+
+#endif
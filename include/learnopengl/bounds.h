@@ -0,0 +1,158 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/vertex.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define BOUNDS_SSE 1
+#endif
+
+// axis aligned box plus the sphere around it, in whatever space the points were in
+struct Bounds {
+    glm::vec3 minimum = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 maximum = glm::vec3(-std::numeric_limits<float>::max());
+
+    bool Empty() const { return minimum.x > maximum.x; }
+    glm::vec3 Center() const { return (minimum + maximum) * 0.5f; }
+    glm::vec3 Extents() const { return (maximum - minimum) * 0.5f; }
+    float Radius() const { return Empty() ? 0.0f : glm::length(Extents()); }
+
+    void Add(const glm::vec3 &point)
+    {
+        minimum = glm::min(minimum, point);
+        maximum = glm::max(maximum, point);
+    }
+
+    void Add(const Bounds &other)
+    {
+        if (other.Empty())
+            return;
+        minimum = glm::min(minimum, other.minimum);
+        maximum = glm::max(maximum, other.maximum);
+    }
+
+    static Bounds Of(const Vertex *vertices, size_t count)
+    {
+        Bounds bounds;
+        for (size_t i = 0; i < count; i++)
+            bounds.Add(vertices[i].Position);
+        return bounds;
+    }
+
+    // the box around this box moved by 'transform', from its center and extents (Arvo's method)
+    Bounds Transformed(const glm::mat4 &transform) const
+    {
+        if (Empty())
+            return *this;
+        glm::vec3 center = glm::vec3(transform * glm::vec4(Center(), 1.0f));
+        glm::mat3 absolute = glm::mat3(glm::abs(glm::vec3(transform[0])), glm::abs(glm::vec3(transform[1])), glm::abs(glm::vec3(transform[2])));
+        glm::vec3 extents = absolute * Extents();
+        Bounds transformed;
+        transformed.minimum = center - extents;
+        transformed.maximum = center + extents;
+        return transformed;
+    }
+};
+
+// The six planes of a view projection, pointing inwards. Boxes are tested against four planes at once with
+// SSE: the planes are stored as structure of arrays, the last two padded with planes nothing is outside of.
+class Frustum {
+public:
+    Frustum() { Set(glm::mat4(1.0f)); }
+    explicit Frustum(const glm::mat4 &viewProjection) { Set(viewProjection); }
+
+    // extracts the planes from the rows of 'viewProjection' (Gribb/Hartmann)
+    void Set(const glm::mat4 &viewProjection)
+    {
+        glm::vec4 rows[4];
+        for (int row = 0; row < 4; row++)
+            rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row]);
+        glm::vec4 planes[PlaneCount] = {
+            rows[3] + rows[0], rows[3] - rows[0], // left, right
+            rows[3] + rows[1], rows[3] - rows[1], // bottom, top
+            rows[3] + rows[2], rows[3] - rows[2], // near, far
+            glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
+        };
+        for (int i = 0; i < PlaneCount; i++)
+        {
+            float length = glm::length(glm::vec3(planes[i]));
+            glm::vec4 plane = length > 0.0f ? planes[i] / length : planes[i];
+            x[i] = plane.x; y[i] = plane.y; z[i] = plane.z; w[i] = plane.w;
+            absX[i] = std::fabs(plane.x); absY[i] = std::fabs(plane.y); absZ[i] = std::fabs(plane.z);
+        }
+    }
+
+    // false when the box is entirely behind one of the planes
+    bool Intersects(const Bounds &box) const
+    {
+        if (box.Empty())
+            return false;
+        glm::vec3 center = box.Center(), extents = box.Extents();
+#ifdef BOUNDS_SSE
+        __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+        __m128 ex = _mm_set1_ps(extents.x), ey = _mm_set1_ps(extents.y), ez = _mm_set1_ps(extents.z);
+        __m128 outside = _mm_setzero_ps();
+        for (int i = 0; i < PlaneCount; i += 4)
+        {
+            // signed distance of the center plus the box's reach towards the plane
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(x + i), cx), _mm_mul_ps(_mm_load_ps(y + i), cy)),
+                                         _mm_add_ps(_mm_mul_ps(_mm_load_ps(z + i), cz), _mm_load_ps(w + i)));
+            __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(absX + i), ex), _mm_mul_ps(_mm_load_ps(absY + i), ey)),
+                                      _mm_mul_ps(_mm_load_ps(absZ + i), ez));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+        }
+        return _mm_movemask_ps(outside) == 0;
+#else
+        for (int i = 0; i < PlaneCount; i++)
+        {
+            float distance = x[i] * center.x + y[i] * center.y + z[i] * center.z + w[i];
+            float reach = absX[i] * extents.x + absY[i] * extents.y + absZ[i] * extents.z;
+            if (distance + reach < 0.0f)
+                return false;
+        }
+        return true;
+#endif
+    }
+
+    // same for 'box' moved by 'transform'
+    bool Intersects(const Bounds &box, const glm::mat4 &transform) const
+    {
+        return Intersects(box.Transformed(transform));
+    }
+
+    // false when the sphere is entirely behind one of the planes
+    bool Intersects(const glm::vec3 &center, float radius) const
+    {
+#ifdef BOUNDS_SSE
+        __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+        __m128 reach = _mm_set1_ps(-radius), outside = _mm_setzero_ps();
+        for (int i = 0; i < PlaneCount; i += 4)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(x + i), cx), _mm_mul_ps(_mm_load_ps(y + i), cy)),
+                                         _mm_add_ps(_mm_mul_ps(_mm_load_ps(z + i), cz), _mm_load_ps(w + i)));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, reach));
+        }
+        return _mm_movemask_ps(outside) == 0;
+#else
+        for (int i = 0; i < PlaneCount; i++)
+            if (x[i] * center.x + y[i] * center.y + z[i] * center.z + w[i] < -radius)
+                return false;
+        return true;
+#endif
+    }
+
+private:
+    static const int PlaneCount = 8;
+    alignas(16) float x[PlaneCount], y[PlaneCount], z[PlaneCount], w[PlaneCount];
+    alignas(16) float absX[PlaneCount], absY[PlaneCount], absZ[PlaneCount];
+};
+
+#endif
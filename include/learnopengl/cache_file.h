@@ -0,0 +1,96 @@
+#ifndef CACHE_FILE_H
+#define CACHE_FILE_H
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// helpers shared by the on-disk caches (meshes, textures, shader programs)
+
+// read-only view of a whole file, mapped into memory and unmapped again on destruction
+class MappedFile
+{
+public:
+    MappedFile() : data(nullptr), size(0) {}
+    explicit MappedFile(const std::string &path) : data(nullptr), size(0) { open(path); }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string &path)
+    {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void *mapped = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED)
+            {
+                data = (const unsigned char*)mapped;
+                size = (size_t)st.st_size;
+            }
+        }
+        ::close(fd);
+        return data != nullptr;
+    }
+
+    void close()
+    {
+        if (data)
+            munmap((void*)data, size);
+        data = nullptr;
+        size = 0;
+    }
+
+    bool isOpen() const { return data != nullptr; }
+
+    const unsigned char *data;
+    size_t size;
+};
+
+// 64-bit FNV-1a, used both for content hashes and for naming cache files
+inline uint64_t HashBytes(const void *bytes, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    const unsigned char *p = (const unsigned char*)bytes;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// faster content hash for large files (textures): FNV style mixing over 8 byte words instead of single bytes
+inline uint64_t HashWords(const void *bytes, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    const unsigned char *p = (const unsigned char*)bytes;
+    size_t words = size / 8;
+    for (size_t i = 0; i < words; i++)
+    {
+        uint64_t word;
+        std::memcpy(&word, p + i * 8, 8);
+        hash = (hash ^ word) * 1099511628211ull;
+        hash ^= hash >> 29;
+    }
+    return HashBytes(p + words * 8, size - words * 8, hash);
+}
+
+// mkdir -p
+inline void CreateDirectories(const std::string &directory)
+{
+    for (std::string::size_type slash = directory.find('/'); slash != std::string::npos; slash = directory.find('/', slash + 1))
+        mkdir(directory.substr(0, slash).c_str(), 0755);
+    mkdir(directory.c_str(), 0755);
+}
+
+#endif
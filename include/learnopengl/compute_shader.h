@@ -0,0 +1,64 @@
+#ifndef COMPUTE_SHADER_H
+#define COMPUTE_SHADER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// a program made of a single compute shader; uniforms work exactly like with Shader
+class ComputeShader : public Shader
+{
+public:
+    explicit ComputeShader(const char* computePath)
+    {
+        std::string computeCode;
+        std::ifstream cShaderFile;
+        cShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            cShaderFile.open(computePath);
+            std::stringstream cShaderStream;
+            cShaderStream << cShaderFile.rdbuf();
+            cShaderFile.close();
+            computeCode = cShaderStream.str();
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        }
+        computeCode = ShaderSource::ResolveIncludes(computeCode, computePath);
+        uint64_t cacheKey = ProgramCache::KeyFor({ computeCode });
+        ID = ProgramCache::Load(cacheKey);
+        if (ID)
+        {
+            reflectUniforms();
+            return;
+        }
+        const char* cShaderCode = computeCode.c_str();
+        unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(compute, 1, &cShaderCode, NULL);
+        glCompileShader(compute);
+        checkCompileErrors(compute, "COMPUTE");
+        ID = glCreateProgram();
+        ProgramCache::MarkRetrievable(ID);
+        glAttachShader(ID, compute);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        ProgramCache::Store(cacheKey, ID);
+        glDeleteShader(compute);
+
+        reflectUniforms();
+    }
+
+    // runs the shader over a grid of work groups; the program must be in use
+    void dispatch(unsigned int groupsX, unsigned int groupsY = 1, unsigned int groupsZ = 1) const
+    {
+        glDispatchCompute(groupsX, groupsY, groupsZ);
+    }
+};
+#endif
@@ -0,0 +1,91 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+// Render targets of the deferred path, 8 bytes per pixel plus depth:
+//   0: RGBA8  albedo rgb, specular intensity in a
+//   1: RG16   octahedral encoded world space normal
+//   depth: DEPTH_COMPONENT24 texture, world position is reconstructed from it
+// The depth format matches the HDR framebuffer's depth buffer so it can be blitted over for the skybox.
+class GBuffer {
+public:
+    unsigned int FBO = 0;
+    unsigned int albedoSpecular = 0, normal = 0, depth = 0;
+
+    GBuffer(unsigned int width, unsigned int height) : width(width), height(height)
+    {
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        albedoSpecular = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        normal = createTarget(GL_RG16, GL_RG, GL_UNSIGNED_SHORT);
+        depth = createTarget(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoSpecular, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "G-buffer framebuffer not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    GBuffer(const GBuffer&) = delete;
+    GBuffer &operator=(const GBuffer&) = delete;
+
+    ~GBuffer()
+    {
+        glDeleteFramebuffers(1, &FBO);
+        unsigned int textures[3] = { albedoSpecular, normal, depth };
+        glDeleteTextures(3, textures);
+    }
+
+    // binds and clears the G-buffer for the geometry pass
+    void Bind()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // albedo/specular, normal and depth on three consecutive texture units
+    void BindTextures(unsigned int firstUnit)
+    {
+        glActiveTexture(GL_TEXTURE0 + firstUnit);
+        glBindTexture(GL_TEXTURE_2D, albedoSpecular);
+        glActiveTexture(GL_TEXTURE0 + firstUnit + 1);
+        glBindTexture(GL_TEXTURE_2D, normal);
+        glActiveTexture(GL_TEXTURE0 + firstUnit + 2);
+        glBindTexture(GL_TEXTURE_2D, depth);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // copies the scene depth into 'framebuffer' and leaves it bound, so forward passes can depth test against it
+    void BlitDepth(unsigned int framebuffer)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    }
+
+private:
+    unsigned int width, height;
+
+    unsigned int createTarget(GLenum internalFormat, GLenum format, GLenum type)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+};
+
+#endif
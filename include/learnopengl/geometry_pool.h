@@ -0,0 +1,316 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/vertex.h>
+
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <map>
+
+// first fit allocator over a linear range, in whatever unit the owner counts in (vertices, bytes)
+class RangeAllocator {
+public:
+    static const size_t Invalid = ~(size_t)0;
+
+    size_t Capacity() const { return capacity; }
+    size_t Used() const { return used; }
+
+    // appends free space at the end of the range
+    void Grow(size_t newCapacity)
+    {
+        release(capacity, newCapacity - capacity);
+        capacity = newCapacity;
+    }
+
+    // returns the offset of 'size' units aligned to 'alignment', or Invalid when no free block is big enough
+    size_t Allocate(size_t size, size_t alignment = 1)
+    {
+        for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it)
+        {
+            size_t blockStart = it->first, blockEnd = it->first + it->second;
+            size_t start = (blockStart + alignment - 1) / alignment * alignment;
+            if (start + size > blockEnd)
+                continue;
+            freeBlocks.erase(it);
+            if (start > blockStart)
+                freeBlocks[blockStart] = start - blockStart;
+            if (start + size < blockEnd)
+                freeBlocks[start + size] = blockEnd - start - size;
+            used += size;
+            return start;
+        }
+        return Invalid;
+    }
+
+    void Free(size_t offset, size_t size)
+    {
+        used -= size;
+        release(offset, size);
+    }
+
+private:
+    size_t capacity = 0, used = 0;
+    std::map<size_t, size_t> freeBlocks; // offset -> size, neighbours always merged
+
+    void release(size_t offset, size_t size)
+    {
+        if (size == 0)
+            return;
+        auto next = freeBlocks.lower_bound(offset);
+        if (next != freeBlocks.end() && offset + size == next->first)
+        {
+            size += next->second;
+            next = freeBlocks.erase(next);
+        }
+        if (next != freeBlocks.begin())
+        {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == offset)
+            {
+                previous->second += size;
+                return;
+            }
+        }
+        freeBlocks[offset] = size;
+    }
+};
+
+// All static mesh geometry lives in a few large buffers: one vertex buffer per vertex layout and one index
+// buffer shared by all of them. Every layout has a single VAO set up with the separate attribute format
+// (glVertexAttribFormat / glBindVertexBuffer), so meshes only differ by their base vertex and first index and
+// drawing a whole scene needs one VAO bind per layout instead of one per mesh.
+//
+// Positions are not part of the packed vertex: each layout keeps them in a buffer of their own, at the same
+// vertex numbers, read through binding 1. A second VAO per layout reads nothing else, so depth-only passes
+// fetch 12 bytes per vertex instead of the whole vertex.
+//
+// Index ranges hold 16 or 32-bit indices relative to the mesh's base vertex and start 4 byte aligned, so the
+// first index of either type is a whole number. Buffers grow by doubling; the old contents are copied on the
+// GPU, offsets stay valid.
+class GeometryPool {
+public:
+    enum Layout { Packed, PackedWideUV, LayoutCount };
+
+    struct Allocation {
+        Layout layout = Packed;
+        unsigned int baseVertex = 0;
+        unsigned int vertexCount = 0;
+        size_t indexOffset = 0; // in bytes
+        size_t indexBytes = 0;
+    };
+
+    static GeometryPool &Instance()
+    {
+        static GeometryPool pool;
+        return pool;
+    }
+
+    GeometryPool(const GeometryPool&) = delete;
+    GeometryPool &operator=(const GeometryPool&) = delete;
+
+    // deletes the buffers and VAOs. the pool is a static and outlives main(), so this is called explicitly once
+    // the last mesh is gone and while the context is still current; Allocate() would start over afterwards.
+    void Shutdown()
+    {
+        for (Arena &arena : arenas)
+        {
+            glDeleteVertexArrays(1, &arena.VAO);
+            glDeleteVertexArrays(1, &arena.positionVAO);
+            glDeleteBuffers(1, &arena.VBO);
+            glDeleteBuffers(1, &arena.positionVBO);
+            arena = Arena();
+        }
+        glDeleteBuffers(1, &EBO);
+        EBO = 0;
+        indexRanges = RangeAllocator();
+    }
+
+    // copies packed vertices of 'layout', their positions and their indices into the pool. must be called on the
+    // context thread.
+    Allocation Allocate(Layout layout, const void *vertices, const glm::vec3 *positions, size_t vertexCount, const void *indices,
+                        size_t indexBytes)
+    {
+        createVertexArrays();
+        Arena &arena = arenas[layout];
+        Allocation allocation;
+        allocation.layout = layout;
+        allocation.vertexCount = (unsigned int)vertexCount;
+        allocation.indexBytes = indexBytes;
+
+        size_t baseVertex = arena.vertices.Allocate(vertexCount);
+        if (baseVertex == RangeAllocator::Invalid)
+        {
+            growVertices(arena, vertexCount);
+            baseVertex = arena.vertices.Allocate(vertexCount);
+        }
+        allocation.baseVertex = (unsigned int)baseVertex;
+        size_t indexOffset = indexRanges.Allocate(indexBytes, IndexAlignment);
+        if (indexOffset == RangeAllocator::Invalid)
+        {
+            growIndices(indexBytes + IndexAlignment);
+            indexOffset = indexRanges.Allocate(indexBytes, IndexAlignment);
+        }
+        allocation.indexOffset = indexOffset;
+
+        // uploads go through the copy target so the element array binding of whatever VAO is bound stays put
+        glBindBuffer(GL_COPY_WRITE_BUFFER, arena.VBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, baseVertex * arena.stride, vertexCount * arena.stride, vertices);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, arena.positionVBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, baseVertex * sizeof(glm::vec3), vertexCount * sizeof(glm::vec3), positions);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset, indexBytes, indices);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return allocation;
+    }
+
+    void Free(const Allocation &allocation)
+    {
+        arenas[allocation.layout].vertices.Free(allocation.baseVertex, allocation.vertexCount);
+        indexRanges.Free(allocation.indexOffset, allocation.indexBytes);
+    }
+
+    unsigned int VertexArray(Layout layout)
+    {
+        createVertexArrays();
+        return arenas[layout].VAO;
+    }
+
+    // the same vertices and indices, with only attribute 0 (the position) enabled
+    unsigned int PositionVertexArray(Layout layout)
+    {
+        createVertexArrays();
+        return arenas[layout].positionVAO;
+    }
+
+    // bytes in use, for the stats overlay
+    size_t VertexBytes() const
+    {
+        size_t bytes = 0;
+        for (const Arena &arena : arenas)
+            bytes += arena.vertices.Used() * (arena.stride + sizeof(glm::vec3));
+        return bytes;
+    }
+    size_t IndexBytes() const { return indexRanges.Used(); }
+
+private:
+    static const size_t InitialVertices = 1 << 18;
+    static const size_t InitialIndexBytes = 4 << 20;
+    static const size_t IndexAlignment = 4;
+    static const GLuint PositionBinding = 1;
+
+    struct Arena {
+        unsigned int VAO = 0, VBO = 0;
+        unsigned int positionVAO = 0, positionVBO = 0;
+        size_t stride = 0;
+        RangeAllocator vertices;
+    };
+    Arena arenas[LayoutCount];
+    unsigned int EBO = 0;
+    RangeAllocator indexRanges;
+
+    GeometryPool() {}
+
+    void createVertexArrays()
+    {
+        if (arenas[Packed].VAO)
+            return;
+        createVertexArray<PackedVertex>(arenas[Packed], GL_HALF_FLOAT);
+        createVertexArray<PackedVertexWideUV>(arenas[PackedWideUV], GL_FLOAT);
+    }
+
+    // the vertex format of a layout: positions through binding 1, everything else through binding 0
+    template<typename PackedType>
+    void createVertexArray(Arena &arena, GLenum texCoordType)
+    {
+        arena.stride = sizeof(PackedType);
+        glGenVertexArrays(1, &arena.VAO);
+        glBindVertexArray(arena.VAO);
+        // vertex Positions
+        enablePositions();
+        // vertex normals
+        glEnableVertexAttribArray(1);
+        glVertexAttribFormat(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedType, Normal));
+        glVertexAttribBinding(1, 0);
+        // vertex texture coords
+        glEnableVertexAttribArray(2);
+        glVertexAttribFormat(2, 2, texCoordType, GL_FALSE, offsetof(PackedType, TexCoords));
+        glVertexAttribBinding(2, 0);
+        // vertex tangent, w = bitangent sign
+        glEnableVertexAttribArray(3);
+        glVertexAttribFormat(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedType, Tangent));
+        glVertexAttribBinding(3, 0);
+
+        glGenVertexArrays(1, &arena.positionVAO);
+        glBindVertexArray(arena.positionVAO);
+        enablePositions();
+        glBindVertexArray(0);
+    }
+
+    static void enablePositions()
+    {
+        glEnableVertexAttribArray(0);
+        glVertexAttribFormat(0, 3, GL_FLOAT, GL_FALSE, 0);
+        glVertexAttribBinding(0, PositionBinding);
+    }
+
+    // replaces 'buffer' by a bigger one holding the same first 'oldSize' bytes
+    static unsigned int resizeBuffer(unsigned int buffer, size_t oldSize, size_t newSize)
+    {
+        unsigned int resized;
+        glGenBuffers(1, &resized);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, resized);
+        glBufferData(GL_COPY_WRITE_BUFFER, newSize, nullptr, GL_STATIC_DRAW);
+        if (buffer)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glDeleteBuffers(1, &buffer);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return resized;
+    }
+
+    static size_t grownCapacity(size_t capacity, size_t initial, size_t needed)
+    {
+        size_t grown = capacity ? capacity * 2 : initial;
+        while (grown < capacity + needed)
+            grown *= 2;
+        return grown;
+    }
+
+    void growVertices(Arena &arena, size_t needed)
+    {
+        size_t capacity = grownCapacity(arena.vertices.Capacity(), InitialVertices, needed);
+        arena.VBO = resizeBuffer(arena.VBO, arena.vertices.Capacity() * arena.stride, capacity * arena.stride);
+        arena.positionVBO = resizeBuffer(arena.positionVBO, arena.vertices.Capacity() * sizeof(glm::vec3), capacity * sizeof(glm::vec3));
+        arena.vertices.Grow(capacity);
+        glBindVertexArray(arena.VAO);
+        glBindVertexBuffer(0, arena.VBO, 0, (GLsizei)arena.stride);
+        glBindVertexBuffer(PositionBinding, arena.positionVBO, 0, sizeof(glm::vec3));
+        glBindVertexArray(arena.positionVAO);
+        glBindVertexBuffer(PositionBinding, arena.positionVBO, 0, sizeof(glm::vec3));
+        glBindVertexArray(0);
+    }
+
+    void growIndices(size_t needed)
+    {
+        size_t capacity = grownCapacity(indexRanges.Capacity(), InitialIndexBytes, needed);
+        EBO = resizeBuffer(EBO, indexRanges.Capacity(), capacity);
+        indexRanges.Grow(capacity);
+        // the element array binding is VAO state
+        for (Arena &arena : arenas)
+            for (unsigned int vao : { arena.VAO, arena.positionVAO })
+            {
+                glBindVertexArray(vao);
+                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+            }
+        glBindVertexArray(0);
+    }
+};
+
+#endif
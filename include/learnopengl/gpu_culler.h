@@ -0,0 +1,73 @@
+#ifndef GPU_CULLER_H
+#define GPU_CULLER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/compute_shader.h>
+#include <learnopengl/hiz_pyramid.h>
+#include <learnopengl/mesh.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// one instance of one queued mesh: which ObjectBlock it is, which draw command it belongs to and the mesh's
+// model space bounds. keep in sync with instance_cull.comp.
+struct CullRecord {
+    uint32_t object;
+    uint32_t command;
+    uint32_t padding[2];
+    glm::vec4 center;
+    glm::vec4 extents;
+};
+
+// Visibility on the GPU. A compute pass tests every instance of every queued mesh against the view frustum and
+// against a HiZPyramid of the previous frame's depth, then appends the survivors to their mesh's draw command:
+// an atomic add on its instanceCount picks the slot among the command's object indices. The commands go to
+// glMultiDrawElementsIndirect straight from the buffer they were culled in, so no visibility result ever comes
+// back to the CPU, and the CPU cost no longer grows with what is hidden.
+//
+// Storage buffers, shared with instance_cull.comp:
+//   4: ObjectBlocks, read (see uniform_blocks.h)
+//   5: object indices, written from each command's baseInstance on
+//   6: CullRecords, one per instance
+//   7: the frame's DrawElementsIndirectCommands, submitted with an instanceCount of 0
+class GpuCuller {
+public:
+    static const unsigned int CullGroupSize = 64;
+    static const GLuint RecordBinding = 6, CommandBinding = 7;
+
+    GpuCuller(const char *cullShaderPath, const HiZPyramid &pyramid) : cullShader(cullShaderPath), pyramid(pyramid)
+    {
+        recordCountUniform = cullShader.handle<int>("recordCount");
+        occlusionTestUniform = cullShader.handle<bool>("occlusionTest");
+        previousViewProjectionUniform = cullShader.handle<glm::mat4>("previousViewProjection");
+    }
+
+    // culls 'recordCount' CullRecords into 'commandCount' commands, both in 'buffer'. the View uniform block
+    // and the objects must be bound. without a built pyramid, only the frustum test runs.
+    void Cull(unsigned int buffer, size_t recordsOffset, size_t recordCount, size_t commandsOffset, size_t commandCount)
+    {
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, RecordBinding, buffer, (GLintptr)recordsOffset, (GLsizeiptr)(recordCount * sizeof(CullRecord)));
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, CommandBinding, buffer, (GLintptr)commandsOffset,
+                          (GLsizeiptr)(commandCount * sizeof(DrawElementsIndirectCommand)));
+        cullShader.use();
+        cullShader.set(recordCountUniform, (int)recordCount);
+        cullShader.set(occlusionTestUniform, pyramid.Built());
+        cullShader.set(previousViewProjectionUniform, pyramid.ViewProjection());
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, pyramid.Texture());
+        cullShader.dispatch((unsigned int)((recordCount + CullGroupSize - 1) / CullGroupSize));
+        // the draws read the instance counts as indirect commands and the object indices as a storage buffer
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+private:
+    ComputeShader cullShader;
+    const HiZPyramid &pyramid;
+    UniformHandle<int> recordCountUniform;
+    UniformHandle<bool> occlusionTestUniform;
+    UniformHandle<glm::mat4> previousViewProjectionUniform;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef HIZ_PYRAMID_H
+#define HIZ_PYRAMID_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/compute_shader.h>
+
+#include <algorithm>
+
+// Hierarchical-Z: a depth buffer copied into level 0 of a single channel float texture, and every further mip
+// level holding the farthest depth of the 2x2 texels below it (the last row and column of an odd sized level
+// go to the texels at its edge). A texel of level n then bounds the depth of 2^n x 2^n pixels, so a screen
+// rectangle is checked with at most 2x2 fetches from the level where it is one or two texels wide.
+//
+// Built from the depth a frame ended with, it is the occlusion data of the next frame, together with the view
+// projection it was drawn with. hiz_build.comp reduces one level per dispatch.
+class HiZPyramid {
+public:
+    static const unsigned int GroupSize = 8;
+
+    HiZPyramid(const char *buildShaderPath, int width, int height) : buildShader(buildShaderPath), width(width), height(height)
+    {
+        while ((std::max(width, height) >> levels) > 0)
+            levels++;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexStorage2D(GL_TEXTURE_2D, levels, GL_R32F, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        fromDepthUniform = buildShader.handle<bool>("fromDepth");
+    }
+
+    HiZPyramid(const HiZPyramid&) = delete;
+    HiZPyramid &operator=(const HiZPyramid&) = delete;
+
+    ~HiZPyramid()
+    {
+        glDeleteTextures(1, &texture);
+    }
+
+    // rebuilds every level from 'depthTexture', a width x height depth texture drawn with 'viewProjection'.
+    // leaves the build shader in use and 'depthTexture' bound to unit 0.
+    void Build(unsigned int depthTexture, const glm::mat4 &viewProjection)
+    {
+        buildShader.use();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        for (int level = 0; level < levels; level++)
+        {
+            // level 0 reads the depth texture, the source image is bound but unused
+            glBindImageTexture(0, texture, std::max(level - 1, 0), GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+            glBindImageTexture(1, texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+            buildShader.set(fromDepthUniform, level == 0);
+            unsigned int levelWidth = std::max(width >> level, 1), levelHeight = std::max(height >> level, 1);
+            buildShader.dispatch((levelWidth + GroupSize - 1) / GroupSize, (levelHeight + GroupSize - 1) / GroupSize);
+            // the next level reads this one through its image unit
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        }
+        // the culling pass samples the pyramid as a texture
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        builtViewProjection = viewProjection;
+        built = true;
+    }
+
+    // the contents no longer match the scene, e.g. after frames without Build()
+    void Invalidate() { built = false; }
+
+    bool Built() const { return built; }
+    unsigned int Texture() const { return texture; }
+    int Levels() const { return levels; }
+    const glm::mat4 &ViewProjection() const { return builtViewProjection; }
+
+private:
+    ComputeShader buildShader;
+    UniformHandle<bool> fromDepthUniform;
+    int width, height, levels = 1;
+    unsigned int texture = 0;
+    glm::mat4 builtViewProjection = glm::mat4(1.0f);
+    bool built = false;
+};
+
+#endif
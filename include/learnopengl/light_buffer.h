@@ -0,0 +1,174 @@
+#ifndef LIGHT_BUFFER_H
+#define LIGHT_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+struct PointLight {
+    glm::vec3 position;
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct SpotLight {
+    glm::vec3 position;
+    glm::vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+};
+
+struct DirLight {
+    glm::vec3 direction;
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+};
+
+enum LightType : unsigned int {
+    PointLightType = 0,
+    SpotLightType = 1
+};
+
+// contributions below this are cut off, which bounds every point and spot light to a sphere clusters can be
+// tested against. the shader fades lights out towards that range, so the cut leaves no visible edge.
+const float LightCutoff = 1.0f / 64.0f;
+
+// distance at which the light's brightest channel, attenuated by 1 / (constant + linear d + quadratic d^2),
+// falls to LightCutoff
+inline float LightRange(float constant, float linear, float quadratic, const glm::vec3 &ambient, const glm::vec3 &diffuse,
+                        const glm::vec3 &specular)
+{
+    glm::vec3 brightest = glm::max(ambient, glm::max(diffuse, specular));
+    float target = std::max(brightest.r, std::max(brightest.g, brightest.b)) / LightCutoff;
+    float c = constant - target;
+    if (c >= 0.0f)
+        return 0.0f;
+    if (quadratic > 0.0f)
+        return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * c)) / (2.0f * quadratic);
+    if (linear > 0.0f)
+        return -c / linear;
+    return 1e30f;
+}
+
+// std430 layouts of the light storage buffer, see resources/shaders/lights.glsl
+struct GpuLight {
+    glm::vec4 position;    // xyz, w: LightType
+    glm::vec4 direction;   // xyz: spot direction
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    glm::vec4 specular;
+    glm::vec4 attenuation; // constant, linear, quadratic, range
+    glm::vec4 cone;        // x: cos of the inner cone, y: cos of the outer cone
+};
+
+struct GpuDirLight {
+    glm::vec4 direction;
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    glm::vec4 specular;
+};
+
+struct LightBufferHeader {
+    GpuDirLight dirLight;
+    glm::uvec4 counts;     // x: number of lights following the header
+};
+
+// The scene's lights as one typed array in a shader storage buffer, rebuilt by the application every frame.
+// Shaders loop over however many lights there are, so adding lights needs no shader changes.
+class LightBuffer {
+public:
+    static const GLuint Binding = 0;
+
+    LightBuffer() {}
+    LightBuffer(const LightBuffer&) = delete;
+    LightBuffer &operator=(const LightBuffer&) = delete;
+
+    ~LightBuffer()
+    {
+        glDeleteBuffers(1, &buffer);
+    }
+
+    void Clear()
+    {
+        lights.clear();
+    }
+
+    void SetDirectional(const DirLight &light)
+    {
+        GpuDirLight &gpu = header.dirLight;
+        gpu.direction = glm::vec4(light.direction, 0.0f);
+        gpu.ambient = glm::vec4(light.ambient, 0.0f);
+        gpu.diffuse = glm::vec4(light.diffuse, 0.0f);
+        gpu.specular = glm::vec4(light.specular, 0.0f);
+    }
+
+    void Add(const PointLight &light)
+    {
+        GpuLight gpu = {};
+        gpu.position = glm::vec4(light.position, (float)PointLightType);
+        gpu.ambient = glm::vec4(light.ambient, 0.0f);
+        gpu.diffuse = glm::vec4(light.diffuse, 0.0f);
+        gpu.specular = glm::vec4(light.specular, 0.0f);
+        gpu.attenuation = glm::vec4(light.constant, light.linear, light.quadratic,
+                                    LightRange(light.constant, light.linear, light.quadratic, light.ambient, light.diffuse, light.specular));
+        lights.push_back(gpu);
+    }
+
+    void Add(const SpotLight &light)
+    {
+        GpuLight gpu = {};
+        gpu.position = glm::vec4(light.position, (float)SpotLightType);
+        gpu.direction = glm::vec4(light.direction, 0.0f);
+        gpu.ambient = glm::vec4(light.ambient, 0.0f);
+        gpu.diffuse = glm::vec4(light.diffuse, 0.0f);
+        gpu.specular = glm::vec4(light.specular, 0.0f);
+        gpu.attenuation = glm::vec4(light.constant, light.linear, light.quadratic,
+                                    LightRange(light.constant, light.linear, light.quadratic, light.ambient, light.diffuse, light.specular));
+        gpu.cone = glm::vec4(light.cutOff, light.outerCutOff, 0.0f, 0.0f);
+        lights.push_back(gpu);
+    }
+
+    size_t Count() const { return lights.size(); }
+
+    // copies header and lights into the storage buffer, orphaning last frame's copy, and binds it
+    void Upload()
+    {
+        header.counts = glm::uvec4((unsigned int)lights.size(), 0, 0, 0);
+        size_t size = sizeof(LightBufferHeader) + lights.size() * sizeof(GpuLight);
+        if (!buffer)
+            glGenBuffers(1, &buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        capacity = std::max(capacity, size);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity, nullptr, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(LightBufferHeader), &header);
+        if (!lights.empty())
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(LightBufferHeader), lights.size() * sizeof(GpuLight), lights.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, Binding, buffer);
+    }
+
+private:
+    unsigned int buffer = 0;
+    size_t capacity = 0;
+    LightBufferHeader header = {};
+    std::vector<GpuLight> lights;
+};
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/compute_shader.h>
+
+#include <cmath>
+#include <initializer_list>
+#include <vector>
+
+// Clustered forward shading: the view frustum is divided into GridX x GridY screen tiles and GridZ depth
+// slices (exponentially spaced, so clusters stay roughly cubic), and a compute pass lists the lights whose
+// range sphere touches each cluster. Fragments then only loop over the lights of their own cluster.
+//
+// Storage buffers, shared with clustered_lighting.glsl and cluster_cull.comp:
+//   1: view space AABB of every cluster (min, max), rebuilt on the CPU when the projection changes
+//   2: number of lights touching each cluster, more than MaxLightsPerCluster when some were dropped
+//   3: light indices, MaxLightsPerCluster slots per cluster
+//   8: clusters that had more lights than slots and the lights they dropped, read back a few frames late
+class LightClusters {
+public:
+    // keep in sync with the shaders
+    static const unsigned int GridX = 16, GridY = 9, GridZ = 24;
+    static const unsigned int ClusterCount = GridX * GridY * GridZ;
+    static const unsigned int MaxLightsPerCluster = 256;
+    static const unsigned int CullGroupSize = 128;
+
+    static const GLuint AabbBinding = 1, CountBinding = 2, IndexBinding = 3, OverflowBinding = 8;
+    // overflow counters in flight; a frame's counters are read once their fence has signalled
+    static const unsigned int OverflowFrames = 3;
+
+    explicit LightClusters(const char *cullShaderPath) : cullShader(cullShaderPath)
+    {
+        glGenBuffers(1, &aabbBuffer);
+        glGenBuffers(1, &countBuffer);
+        glGenBuffers(1, &indexBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, aabbBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, ClusterCount * 2 * sizeof(glm::vec4), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, ClusterCount * sizeof(unsigned int), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, indexBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, ClusterCount * MaxLightsPerCluster * sizeof(unsigned int), nullptr, GL_DYNAMIC_COPY);
+        for (OverflowSlot &slot : overflowSlots)
+        {
+            glGenBuffers(1, &slot.buffer);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.buffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * sizeof(unsigned int), nullptr, GL_DYNAMIC_READ);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        clusterCountUniform = cullShader.handle<int>("clusterCount");
+    }
+
+    LightClusters(const LightClusters&) = delete;
+    LightClusters &operator=(const LightClusters&) = delete;
+
+    ~LightClusters()
+    {
+        glDeleteBuffers(1, &aabbBuffer);
+        glDeleteBuffers(1, &countBuffer);
+        glDeleteBuffers(1, &indexBuffer);
+        for (OverflowSlot &slot : overflowSlots)
+        {
+            if (slot.fence)
+                glDeleteSync(slot.fence);
+            glDeleteBuffers(1, &slot.buffer);
+        }
+    }
+
+    // bins the lights of the bound light buffer into the clusters of this projection. the View uniform
+    // block must be bound, the cull shader reads the view matrix from it.
+    void Cull(const glm::mat4 &projection, float zNear, float zFar)
+    {
+        if (projection != builtProjection || zNear != builtNear || zFar != builtFar)
+            uploadAabbs(projection, zNear, zFar);
+
+        OverflowSlot &overflow = overflowSlots[overflowFrame++ % OverflowFrames];
+        readOverflow(overflow);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, AabbBinding, aabbBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CountBinding, countBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, IndexBinding, indexBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OverflowBinding, overflow.buffer);
+        cullShader.use();
+        cullShader.set(clusterCountUniform, (int)ClusterCount);
+        cullShader.dispatch((ClusterCount + CullGroupSize - 1) / CullGroupSize);
+        // the fragment shader reads the lists as storage buffers, the overflow counters are read back
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+        overflow.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // clusters that had more lights than MaxLightsPerCluster and how many lights they lost, from a
+    // frame a few frames back. those lights are missing from the lighting of those clusters.
+    unsigned int OverflowClusters() const { return overflowClusters; }
+    unsigned int DroppedLights() const { return droppedLights; }
+
+    // depth slice boundaries: near * (far / near)^(slice / GridZ)
+    static float SliceDepth(unsigned int slice, float zNear, float zFar)
+    {
+        return zNear * std::pow(zFar / zNear, (float)slice / GridZ);
+    }
+
+    // view space AABB of every cluster, min and max, in the layout of the storage buffer.
+    // every tile's corners are unprojected onto the near plane, then pushed along their eye rays to the
+    // slice's near and far depth; the cluster AABB encloses those eight points
+    static std::vector<glm::vec4> BuildAabbs(const glm::mat4 &projection, float zNear, float zFar)
+    {
+        glm::mat4 inverseProjection = glm::inverse(projection);
+        auto nearPlanePoint = [&inverseProjection](float x, float y) {
+            glm::vec4 point = inverseProjection * glm::vec4(x, y, -1.0f, 1.0f);
+            return glm::vec3(point) / point.w;
+        };
+
+        std::vector<glm::vec4> aabbs(ClusterCount * 2);
+        for (unsigned int z = 0; z < GridZ; z++)
+        {
+            float sliceNear = SliceDepth(z, zNear, zFar), sliceFar = SliceDepth(z + 1, zNear, zFar);
+            for (unsigned int y = 0; y < GridY; y++)
+            {
+                for (unsigned int x = 0; x < GridX; x++)
+                {
+                    float x0 = (float)x / GridX * 2.0f - 1.0f, x1 = (float)(x + 1) / GridX * 2.0f - 1.0f;
+                    float y0 = (float)y / GridY * 2.0f - 1.0f, y1 = (float)(y + 1) / GridY * 2.0f - 1.0f;
+                    glm::vec3 corners[4] = { nearPlanePoint(x0, y0), nearPlanePoint(x1, y0), nearPlanePoint(x0, y1), nearPlanePoint(x1, y1) };
+                    glm::vec3 minimum(1e30f), maximum(-1e30f);
+                    for (const glm::vec3 &corner : corners)
+                    {
+                        // corner.z is -near: scaling the point moves it along its ray to any depth
+                        for (float depth : { sliceNear, sliceFar })
+                        {
+                            glm::vec3 point = corner * (depth / -corner.z);
+                            minimum = glm::min(minimum, point);
+                            maximum = glm::max(maximum, point);
+                        }
+                    }
+                    unsigned int cluster = x + y * GridX + z * GridX * GridY;
+                    aabbs[cluster * 2] = glm::vec4(minimum, 0.0f);
+                    aabbs[cluster * 2 + 1] = glm::vec4(maximum, 0.0f);
+                }
+            }
+        }
+        return aabbs;
+    }
+
+private:
+    struct OverflowSlot {
+        unsigned int buffer = 0;
+        GLsync fence = 0;
+    };
+
+    ComputeShader cullShader;
+    UniformHandle<int> clusterCountUniform;
+    unsigned int aabbBuffer = 0, countBuffer = 0, indexBuffer = 0;
+    glm::mat4 builtProjection = glm::mat4(0.0f);
+    float builtNear = 0.0f, builtFar = 0.0f;
+    OverflowSlot overflowSlots[OverflowFrames];
+    unsigned int overflowFrame = 0;
+    unsigned int overflowClusters = 0, droppedLights = 0;
+
+    void uploadAabbs(const glm::mat4 &projection, float zNear, float zFar)
+    {
+        std::vector<glm::vec4> aabbs = BuildAabbs(projection, zNear, zFar);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, aabbBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, aabbs.size() * sizeof(glm::vec4), aabbs.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        builtProjection = projection;
+        builtNear = zNear;
+        builtFar = zFar;
+    }
+
+    // takes the counters of the frame that last used this slot, if the GPU is done with it, and zeroes them
+    // for this frame. a slot still in flight keeps the previous numbers rather than waiting.
+    void readOverflow(OverflowSlot &slot)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.buffer);
+        if (slot.fence && glClientWaitSync(slot.fence, 0, 0) != GL_TIMEOUT_EXPIRED)
+        {
+            unsigned int counters[2];
+            glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counters), counters);
+            overflowClusters = counters[0];
+            droppedLights = counters[1];
+        }
+        if (slot.fence)
+        {
+            glDeleteSync(slot.fence);
+            slot.fence = 0;
+        }
+        const unsigned int zero[2] = { 0, 0 };
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), zero);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+};
+
+#endif
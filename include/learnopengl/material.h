@@ -0,0 +1,135 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// owns a GL texture name; shared by every mesh and model that samples the texture
+struct TextureObject {
+    unsigned int id;
+    explicit TextureObject(unsigned int id) : id(id) {}
+    ~TextureObject() { glDeleteTextures(1, &id); }
+};
+
+struct Texture {
+    unsigned int id;
+    std::string type;
+    std::string path;
+    std::shared_ptr<TextureObject> object; // keeps 'id' alive, empty until the texture has been loaded
+};
+
+// Every sampler name a material can fill ("texture_diffuse1", "texture_specular1", ...) owns one texture unit
+// for the whole run. Units never change, so a program's sampler uniforms are set once instead of per draw.
+class MaterialSlots {
+public:
+    static unsigned int UnitFor(const std::string &samplerName)
+    {
+        std::vector<std::string> &slots = names();
+        for (unsigned int unit = 0; unit < slots.size(); unit++)
+            if (slots[unit] == samplerName)
+                return unit;
+        slots.push_back(samplerName);
+        return (unsigned int)slots.size() - 1;
+    }
+
+    static unsigned int Count() { return (unsigned int)names().size(); }
+
+    // points the sampler uniforms prefix + slot name of 'shader' at their units. a program/prefix pair is only
+    // set up once, later calls just cover slots added since. the program must be in use.
+    static void Configure(const Shader &shader, const std::string &prefix)
+    {
+        size_t &configuredSlots = configured()[std::make_pair(shader.ID, prefix)];
+        const std::vector<std::string> &slots = names();
+        for (; configuredSlots < slots.size(); configuredSlots++)
+            glUniform1i(shader.location(prefix + slots[configuredSlots]), (GLint)configuredSlots);
+    }
+
+private:
+    // the samplers of the scene shaders come first, so they get the lowest units
+    static std::vector<std::string> &names()
+    {
+        static std::vector<std::string> slots = { "texture_diffuse1", "texture_specular1", "texture_normal1", "texture_height1" };
+        return slots;
+    }
+
+    static std::map<std::pair<unsigned int, std::string>, size_t> &configured()
+    {
+        static std::map<std::pair<unsigned int, std::string>, size_t> programs;
+        return programs;
+    }
+};
+
+// The textures of a material laid out by texture unit, resolved once when the mesh is created. Meshes with
+// the same textures share one Material, so binding it is a single glBindTextures and consecutive meshes of
+// one material can skip it.
+class Material {
+public:
+    void Bind() const
+    {
+        if (!textures.empty())
+            glBindTextures(0, (GLsizei)textures.size(), textures.data());
+    }
+
+    // small serial number, in order of creation. used to group draws by material.
+    unsigned int Id() const { return id; }
+
+    // the shared material for a mesh's textures. samplers are numbered per type in order, as the importer
+    // lists them: the first diffuse texture is texture_diffuse1, the second texture_diffuse2 and so on.
+    static std::shared_ptr<const Material> For(const std::vector<Texture> &meshTextures)
+    {
+        std::vector<GLuint> units;
+        std::map<std::string, unsigned int> typeCounts;
+        for (const Texture &texture : meshTextures)
+        {
+            unsigned int unit = MaterialSlots::UnitFor(texture.type + std::to_string(++typeCounts[texture.type]));
+            if (units.size() <= unit)
+                units.resize(unit + 1, 0);
+            units[unit] = texture.id;
+        }
+        // a sampler without a texture used to read unit 0, the first texture, since it was never set.
+        // filling the gaps with that texture keeps meshes without e.g. a specular map looking the same.
+        units.resize(std::max<size_t>(units.size(), MaterialSlots::Count()), 0);
+        GLuint fallback = meshTextures.empty() ? 0 : meshTextures[0].id;
+        for (GLuint &unit : units)
+            if (unit == 0)
+                unit = fallback;
+
+        std::weak_ptr<const Material> &entry = interned()[units];
+        std::shared_ptr<const Material> material = entry.lock();
+        if (!material)
+        {
+            std::shared_ptr<Material> created = std::make_shared<Material>();
+            created->textures = units;
+            created->id = nextId()++;
+            material = created;
+            entry = material;
+        }
+        return material;
+    }
+
+private:
+    std::vector<GLuint> textures; // GL texture per unit, see MaterialSlots
+    unsigned int id = 0;
+
+    static unsigned int &nextId()
+    {
+        static unsigned int id = 0;
+        return id;
+    }
+
+    static std::map<std::vector<GLuint>, std::weak_ptr<const Material>> &interned()
+    {
+        static std::map<std::vector<GLuint>, std::weak_ptr<const Material>> materials;
+        return materials;
+    }
+};
+
+#endif
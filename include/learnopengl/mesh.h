@@ -6,31 +6,71 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/bounds.h>
+#include <learnopengl/geometry_pool.h>
+#include <learnopengl/material.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/vertex.h>
 
+#include <cmath>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 using namespace std;
 
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
+// owns the mesh's ranges of the geometry pool; copies of a Mesh share them
+struct MeshBuffers {
+    GeometryPool::Allocation allocation;
+    ~MeshBuffers() { GeometryPool::Instance().Free(allocation); }
 };
 
+// one level of detail: a range of the mesh's index buffer. all levels share the same vertices.
+struct MeshLod {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    float    error; // how far the surface may be off from LOD 0, in model units
+};
 
+// a cluster of neighbouring LOD 0 triangles, a consecutive range of the mesh's indices, with what it takes to
+// cull it on its own (see MeshletBuilder)
+struct Meshlet {
+    uint32_t  indexOffset;
+    uint32_t  indexCount;
+    glm::vec3 center;     // bounding sphere, model space
+    float     radius;
+    glm::vec3 coneAxis;   // average direction of the triangles' normals
+    float     coneCutoff; // sine of the normal cone's half angle, 1 when the normals spread too far to ever cull
+};
 
-struct Texture {
-    unsigned int id;
-    string type;
-    string path;
+// CPU side mesh data produced by the importer. It holds no GL objects, so it can be built on any thread and
+// turned into a Mesh on the context thread later. texture ids are left at 0 until then.
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;
+    vector<Texture>      textures;
+    vector<MeshLod>      lods; // index ranges of the levels of detail, LOD 0 first
+    vector<Meshlet>      meshlets; // LOD 0 in clusters
+
+    // when the mesh comes straight from a mapped cache file these point into the mapping instead of the vectors above
+    const Vertex       *mappedVertices = nullptr;
+    const unsigned int *mappedIndices = nullptr;
+    size_t mappedVertexCount = 0;
+    size_t mappedIndexCount = 0;
+
+    const Vertex *vertexData() const { return mappedVertices ? mappedVertices : vertices.data(); }
+    const unsigned int *indexData() const { return mappedIndices ? mappedIndices : indices.data(); }
+    size_t vertexCount() const { return mappedVertices ? mappedVertexCount : vertices.size(); }
+    size_t indexCount() const { return mappedIndices ? mappedIndexCount : indices.size(); }
+};
+
+// the layout glMultiDrawElementsIndirect reads its draws in
+struct DrawElementsIndirectCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t  baseVertex;
+    uint32_t baseInstance;
 };
 
 class Mesh {
@@ -40,7 +80,17 @@ public:
     vector<unsigned int> indices;
     vector<Texture>      textures;
 
-    unsigned int VAO;
+    unsigned int VAO; // the geometry pool's VAO for this mesh's vertex layout, shared with other meshes
+    unsigned int positionVAO; // the same vertices as positions only, for depth-only passes
+    unsigned int indexCount;
+    GLenum indexType;
+    unsigned int baseVertex; // where the mesh starts in the pool's buffers
+    unsigned int firstIndex; // in units of indexType
+    vector<MeshLod> lods;
+    vector<Meshlet> meshlets; // of LOD 0, empty when it was not split
+    unsigned int activeLod = 0;
+    std::shared_ptr<const Material> material; // the textures by unit, shared with other meshes of the same material
+    Bounds bounds; // in model space
     std::string glslIdentifierPrefix;
     // constructor
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
@@ -48,92 +98,147 @@ public:
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+        material = Material::For(this->textures);
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size());
+    }
+
+    // constructs a mesh straight from externally owned vertex/index memory (e.g. a memory mapped cache file).
+    // the data is only read during construction and no CPU side copy is kept.
+    Mesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount, vector<Texture> textures,
+         vector<MeshLod> lods = vector<MeshLod>(), vector<Meshlet> meshlets = vector<Meshlet>())
+    {
+        this->textures = textures;
+        this->lods = lods;
+        this->meshlets = meshlets;
+        material = Material::For(this->textures);
+        setupMesh(vertexData, vertexCount, indexData, indexCount);
     }
 
+    // triangles drawn at the active level of detail
+    unsigned int TriangleCount() const { return lods[activeLod].indexCount / 3; }
+
     // render the mesh
     void Draw(Shader &shader)
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
+        glBindVertexArray(VAO);
+        DrawBound(shader);
+    }
+
+    // render the mesh, with VAO already bound. lets callers drawing many meshes skip the redundant binds.
+    void DrawBound(Shader &shader)
+    {
+        BindMaterial(shader);
+        DrawElements();
+    }
+
+    // binds the material's textures; the shader must be in use
+    void BindMaterial(Shader &shader)
+    {
+        ConfigureSamplers(shader);
+        material->Bind();
+    }
+
+    // points the shader's samplers at the material units, once per program; the shader must be in use
+    void ConfigureSamplers(const Shader &shader)
+    {
+        if (shader.ID != samplerProgram)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            MaterialSlots::Configure(shader, glslIdentifierPrefix);
+            samplerProgram = shader.ID;
         }
+    }
+
+    // the draw call alone, with VAO and material already bound
+    void DrawElements(GLsizei instanceCount = 1) const
+    {
+        const MeshLod &lod = lods[activeLod];
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, lod.indexCount, indexType, (void*)((firstIndex + lod.indexOffset) * indexSize),
+                                          instanceCount, (GLint)baseVertex);
+    }
 
+    // the same draw as DrawElements(), as an indirect command. its instances read the ObjectBlocks from
+    // 'baseInstance' on.
+    DrawElementsIndirectCommand IndirectCommand(uint32_t instanceCount = 1, uint32_t baseInstance = 0) const
+    {
+        return LodCommand(activeLod, instanceCount, baseInstance);
+    }
 
+    // same at level 'level', which is clamped to the mesh's last one like Model does
+    DrawElementsIndirectCommand LodCommand(unsigned int level, uint32_t instanceCount = 1, uint32_t baseInstance = 0) const
+    {
+        const MeshLod &lod = lods[std::min<size_t>(level, lods.size() - 1)];
+        return { lod.indexCount, instanceCount, firstIndex + lod.indexOffset, (int32_t)baseVertex, baseInstance };
+    }
 
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    // a command for part of the mesh's indices, e.g. a run of consecutive meshlets
+    DrawElementsIndirectCommand RangeCommand(uint32_t indexOffset, uint32_t indexCount, uint32_t instanceCount = 1, uint32_t baseInstance = 0) const
+    {
+        return { indexCount, instanceCount, firstIndex + indexOffset, (int32_t)baseVertex, baseInstance };
+    }
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    void SetTextureNamePrefix(const std::string &prefix)
+    {
+        glslIdentifierPrefix = prefix;
+        samplerProgram = 0;
     }
 
 private:
     // render data
-    unsigned int VBO, EBO;
+    std::shared_ptr<MeshBuffers> buffers;
+    // the program whose sampler uniforms were last checked against MaterialSlots
+    unsigned int samplerProgram = 0;
 
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    // packs the vertices and copies them into the geometry pool. meshes with less than 65536 vertices get
+    // 16-bit indices, which more than halves vertex fetch and index bandwidth.
+    void setupMesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount)
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+        this->indexCount = (unsigned int)indexCount;
+        bounds = Bounds::Of(vertexData, vertexCount);
+        if (lods.empty())
+            lods.push_back({ 0, (uint32_t)indexCount, 0.0f });
+
+        vector<uint16_t> shortIndices;
+        const void *indices = indexData;
+        indexType = GL_UNSIGNED_INT;
+        if (vertexCount <= 65536)
+        {
+            shortIndices.assign(indexData, indexData + indexCount);
+            indices = shortIndices.data();
+            indexType = GL_UNSIGNED_SHORT;
+        }
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+
+        bool halfTexCoords = true;
+        for (size_t i = 0; i < vertexCount && halfTexCoords; i++)
+            halfTexCoords = std::fabs(vertexData[i].TexCoords.x) < HalfTexCoordLimit && std::fabs(vertexData[i].TexCoords.y) < HalfTexCoordLimit;
+        buffers = std::make_shared<MeshBuffers>();
+        if (halfTexCoords)
+            buffers->allocation = uploadVertices<PackedVertex>(GeometryPool::Packed, vertexData, vertexCount, PackVertex, indices, indexCount * indexSize);
+        else
+            buffers->allocation = uploadVertices<PackedVertexWideUV>(GeometryPool::PackedWideUV, vertexData, vertexCount, PackVertexWideUV, indices, indexCount * indexSize);
+
+        VAO = GeometryPool::Instance().VertexArray(buffers->allocation.layout);
+        positionVAO = GeometryPool::Instance().PositionVertexArray(buffers->allocation.layout);
+        baseVertex = buffers->allocation.baseVertex;
+        firstIndex = (unsigned int)(buffers->allocation.indexOffset / indexSize);
+    }
 
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+    // packs the vertices into 'PackedType' and hands them to the pool together with their positions and the indices
+    template<typename PackedType>
+    GeometryPool::Allocation uploadVertices(GeometryPool::Layout layout, const Vertex *vertexData, size_t vertexCount,
+                                            PackedType (*pack)(const Vertex&), const void *indices, size_t indexBytes)
+    {
+        vector<PackedType> packed(vertexCount);
+        vector<glm::vec3> positions(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            packed[i] = pack(vertexData[i]);
+            positions[i] = vertexData[i].Position;
+        }
+        return GeometryPool::Instance().Allocate(layout, packed.data(), positions.data(), vertexCount, indices, indexBytes);
     }
 };
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,270 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/cache_file.h>
+#include <learnopengl/mesh.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Cooked meshes are stored in resources/cache/meshes as one file per source model:
+//
+//   CookedHeader | CookedMesh[meshCount] | CookedTexture[textureCount] | MeshLod[lodCount] | Meshlet[meshletCount] |
+//   string table | vertex and index blobs
+//
+// The file name is derived from the source path and the header records a hash of the source contents,
+// so editing the .obj/.mtl (or bumping the format version) simply causes a re-import on the next run.
+// Blobs are 16-byte aligned so the mapped pointers can be handed to glBufferData as they are.
+namespace MeshCache {
+
+    const uint32_t Magic = 0x434d4752; // "RGMC"
+    const uint32_t Version = 5;
+
+    struct CookedHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sourceHash;
+        uint32_t vertexSize;
+        uint32_t meshCount;
+        uint32_t textureCount;
+        uint32_t lodCount;
+        uint32_t meshletCount;
+        uint32_t stringsSize;
+    };
+
+    struct CookedMesh {
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t firstTexture;
+        uint32_t textureCount;
+        uint32_t firstLod;
+        uint32_t lodCount;
+        uint32_t firstMeshlet;
+        uint32_t meshletCount;
+    };
+
+    struct CookedTexture {
+        uint32_t typeOffset;
+        uint32_t pathOffset;
+    };
+
+    inline std::string Directory()
+    {
+        return "resources/cache/meshes";
+    }
+
+    inline std::string PathFor(const std::string &sourcePath)
+    {
+        char name[17];
+        snprintf(name, sizeof(name), "%016llx", (unsigned long long)HashBytes(sourcePath.data(), sourcePath.size()));
+        return Directory() + '/' + name + ".mesh";
+    }
+
+    // hashes the model file together with its sibling material library (model.obj -> model.mtl),
+    // since texture assignments live in the latter
+    inline uint64_t HashSource(const std::string &sourcePath)
+    {
+        uint64_t hash = HashBytes(&Version, sizeof(Version));
+        MappedFile source(sourcePath);
+        if (!source.isOpen())
+            return 0;
+        hash = HashBytes(source.data, source.size, hash);
+
+        std::string::size_type dot = sourcePath.find_last_of('.');
+        if (dot != std::string::npos)
+        {
+            MappedFile material(sourcePath.substr(0, dot) + ".mtl");
+            if (material.isOpen())
+                hash = HashBytes(material.data, material.size, hash);
+        }
+        return hash;
+    }
+
+    // true when 'offset' starts a NUL terminated string inside the string table
+    inline bool ValidString(const char *strings, uint32_t stringsSize, uint32_t offset)
+    {
+        return offset < stringsSize && std::memchr(strings + offset, '\0', stringsSize - offset) != nullptr;
+    }
+
+    // maps the cooked file and validates it against the current source hash; on success 'file' keeps the
+    // mapping alive and the returned meshes point straight into it. every count, offset and string is checked
+    // against the file, anything that doesn't fit rejects it and the model is imported again.
+    inline bool Load(const std::string &cachePath, uint64_t sourceHash, MappedFile &file, std::vector<MeshData> &meshData)
+    {
+        if (sourceHash == 0 || !file.open(cachePath))
+            return false;
+        if (file.size < sizeof(CookedHeader))
+            return false;
+
+        const CookedHeader *header = (const CookedHeader*)file.data;
+        if (header->magic != Magic || header->version != Version || header->sourceHash != sourceHash ||
+            header->vertexSize != sizeof(Vertex))
+            return false;
+
+        uint64_t tablesSize = sizeof(CookedHeader) + (uint64_t)header->meshCount * sizeof(CookedMesh) +
+                              (uint64_t)header->textureCount * sizeof(CookedTexture) + (uint64_t)header->lodCount * sizeof(MeshLod) +
+                              (uint64_t)header->meshletCount * sizeof(Meshlet) + header->stringsSize;
+        if (tablesSize > file.size)
+            return false;
+
+        const CookedMesh *meshes = (const CookedMesh*)(file.data + sizeof(CookedHeader));
+        const CookedTexture *textures = (const CookedTexture*)(meshes + header->meshCount);
+        const MeshLod *lods = (const MeshLod*)(textures + header->textureCount);
+        const Meshlet *meshlets = (const Meshlet*)(lods + header->lodCount);
+        const char *strings = (const char*)(meshlets + header->meshletCount);
+
+        std::vector<MeshData> loaded;
+        loaded.reserve(header->meshCount);
+        for (uint32_t i = 0; i < header->meshCount; i++)
+        {
+            const CookedMesh &cooked = meshes[i];
+            // every mesh has at least LOD 0, the LOD selection counts down from lodCount - 1
+            if (cooked.vertexOffset + (uint64_t)cooked.vertexCount * sizeof(Vertex) > file.size ||
+                cooked.indexOffset + (uint64_t)cooked.indexCount * sizeof(unsigned int) > file.size ||
+                (uint64_t)cooked.firstTexture + cooked.textureCount > header->textureCount ||
+                cooked.lodCount == 0 || (uint64_t)cooked.firstLod + cooked.lodCount > header->lodCount ||
+                (uint64_t)cooked.firstMeshlet + cooked.meshletCount > header->meshletCount)
+                return false;
+            for (uint32_t l = 0; l < cooked.lodCount; l++)
+            {
+                const MeshLod &lod = lods[cooked.firstLod + l];
+                if ((uint64_t)lod.indexOffset + lod.indexCount > cooked.indexCount)
+                    return false;
+            }
+            for (uint32_t m = 0; m < cooked.meshletCount; m++)
+            {
+                const Meshlet &meshlet = meshlets[cooked.firstMeshlet + m];
+                if ((uint64_t)meshlet.indexOffset + meshlet.indexCount > cooked.indexCount)
+                    return false;
+            }
+
+            MeshData data;
+            data.mappedVertices = (const Vertex*)(file.data + cooked.vertexOffset);
+            data.mappedVertexCount = cooked.vertexCount;
+            data.mappedIndices = (const unsigned int*)(file.data + cooked.indexOffset);
+            data.mappedIndexCount = cooked.indexCount;
+            data.lods.assign(lods + cooked.firstLod, lods + cooked.firstLod + cooked.lodCount);
+            data.meshlets.assign(meshlets + cooked.firstMeshlet, meshlets + cooked.firstMeshlet + cooked.meshletCount);
+            for (uint32_t t = 0; t < cooked.textureCount; t++)
+            {
+                const CookedTexture &cookedTexture = textures[cooked.firstTexture + t];
+                if (!ValidString(strings, header->stringsSize, cookedTexture.typeOffset) ||
+                    !ValidString(strings, header->stringsSize, cookedTexture.pathOffset))
+                    return false;
+                Texture texture;
+                texture.id = 0;
+                texture.type = strings + cookedTexture.typeOffset;
+                texture.path = strings + cookedTexture.pathOffset;
+                data.textures.push_back(texture);
+            }
+            loaded.push_back(data);
+        }
+        meshData = std::move(loaded);
+        return true;
+    }
+
+    // writes the freshly imported meshes next to the other cooked files; goes through a temporary file and a
+    // rename so a crash half way never leaves a truncated cache behind
+    inline bool Store(const std::string &cachePath, uint64_t sourceHash, const std::vector<MeshData> &meshes)
+    {
+        if (sourceHash == 0)
+            return false;
+
+        std::vector<CookedMesh> cookedMeshes;
+        std::vector<CookedTexture> cookedTextures;
+        std::vector<MeshLod> lods;
+        std::vector<Meshlet> meshlets;
+        std::string strings;
+        for (const MeshData &mesh : meshes)
+        {
+            CookedMesh cooked = {};
+            cooked.vertexCount = (uint32_t)mesh.vertexCount();
+            cooked.indexCount = (uint32_t)mesh.indexCount();
+            cooked.firstTexture = (uint32_t)cookedTextures.size();
+            cooked.textureCount = (uint32_t)mesh.textures.size();
+            cooked.firstLod = (uint32_t)lods.size();
+            cooked.lodCount = (uint32_t)mesh.lods.size();
+            lods.insert(lods.end(), mesh.lods.begin(), mesh.lods.end());
+            cooked.firstMeshlet = (uint32_t)meshlets.size();
+            cooked.meshletCount = (uint32_t)mesh.meshlets.size();
+            meshlets.insert(meshlets.end(), mesh.meshlets.begin(), mesh.meshlets.end());
+            for (const Texture &texture : mesh.textures)
+            {
+                CookedTexture cookedTexture;
+                cookedTexture.typeOffset = (uint32_t)strings.size();
+                strings.append(texture.type.c_str(), texture.type.size() + 1);
+                cookedTexture.pathOffset = (uint32_t)strings.size();
+                strings.append(texture.path.c_str(), texture.path.size() + 1);
+                cookedTextures.push_back(cookedTexture);
+            }
+            cookedMeshes.push_back(cooked);
+        }
+
+        auto align = [](uint64_t offset) { return (offset + 15) & ~(uint64_t)15; };
+        uint64_t offset = align(sizeof(CookedHeader) + cookedMeshes.size() * sizeof(CookedMesh) +
+                                cookedTextures.size() * sizeof(CookedTexture) + lods.size() * sizeof(MeshLod) +
+                                meshlets.size() * sizeof(Meshlet) + strings.size());
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            cookedMeshes[i].vertexOffset = offset;
+            offset = align(offset + meshes[i].vertexCount() * sizeof(Vertex));
+            cookedMeshes[i].indexOffset = offset;
+            offset = align(offset + meshes[i].indexCount() * sizeof(unsigned int));
+        }
+
+        CookedHeader header = {};
+        header.magic = Magic;
+        header.version = Version;
+        header.sourceHash = sourceHash;
+        header.vertexSize = sizeof(Vertex);
+        header.meshCount = (uint32_t)cookedMeshes.size();
+        header.textureCount = (uint32_t)cookedTextures.size();
+        header.lodCount = (uint32_t)lods.size();
+        header.meshletCount = (uint32_t)meshlets.size();
+        header.stringsSize = (uint32_t)strings.size();
+
+        CreateDirectories(Directory());
+        // several workers may cook the same model at once (e.g. both eyeballs), so the temporary name is per thread
+        std::string tempPath = cachePath + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+
+        auto padTo = [&out](uint64_t target) {
+            static const char zeros[16] = {};
+            uint64_t position = (uint64_t)out.tellp();
+            if (target > position)
+                out.write(zeros, (std::streamsize)(target - position));
+        };
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)cookedMeshes.data(), (std::streamsize)(cookedMeshes.size() * sizeof(CookedMesh)));
+        out.write((const char*)cookedTextures.data(), (std::streamsize)(cookedTextures.size() * sizeof(CookedTexture)));
+        out.write((const char*)lods.data(), (std::streamsize)(lods.size() * sizeof(MeshLod)));
+        out.write((const char*)meshlets.data(), (std::streamsize)(meshlets.size() * sizeof(Meshlet)));
+        out.write(strings.data(), (std::streamsize)strings.size());
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            padTo(cookedMeshes[i].vertexOffset);
+            out.write((const char*)meshes[i].vertexData(), (std::streamsize)(meshes[i].vertexCount() * sizeof(Vertex)));
+            padTo(cookedMeshes[i].indexOffset);
+            out.write((const char*)meshes[i].indexData(), (std::streamsize)(meshes[i].indexCount() * sizeof(unsigned int)));
+        }
+        out.close();
+        if (!out)
+        {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+        return std::rename(tempPath.c_str(), cachePath.c_str()) == 0;
+    }
+}
+
+#endif
@@ -0,0 +1,291 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// Import time optimization of indexed triangle lists, run once before a mesh gets cooked:
+//
+//   1. weld bit-identical vertices (the OBJ importer emits three unique vertices per triangle)
+//   2. reorder triangles for the post-transform vertex cache (Forsyth's linear-speed algorithm)
+//   3. split that order into clusters and sort the clusters so outward facing ones draw first (less overdraw)
+//   4. reorder vertices by first use so vertex fetch walks the buffer linearly
+//
+// The quality measure is ACMR, the average number of vertices transformed per triangle with a FIFO cache:
+// 3.0 means no reuse at all, ~0.6 is about as good as a regular grid gets.
+namespace MeshOptimizer {
+
+    // counts against a simulated FIFO cache of 'cacheSize' entries, like the hardware uses
+    inline size_t CacheMisses(const std::vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize = 16)
+    {
+        std::vector<size_t> timestamps(vertexCount, 0);
+        size_t time = cacheSize + 1, misses = 0;
+        for (unsigned int index : indices)
+        {
+            if (time - timestamps[index] > cacheSize)
+            {
+                timestamps[index] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+
+    inline float ACMR(const std::vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize = 16)
+    {
+        return indices.empty() ? 0.0f : (float)CacheMisses(indices, vertexCount, cacheSize) / (indices.size() / 3);
+    }
+
+    // merges vertices whose attributes are bit for bit the same
+    inline void WeldVertices(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+    {
+        size_t tableSize = 1;
+        while (tableSize < vertices.size() * 2)
+            tableSize *= 2;
+        const unsigned int empty = ~0u;
+        std::vector<unsigned int> table(tableSize, empty);
+        std::vector<unsigned int> remap(vertices.size());
+        std::vector<Vertex> welded;
+        welded.reserve(vertices.size());
+
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            size_t slot = (size_t)HashBytes(&vertices[i], sizeof(Vertex)) & (tableSize - 1);
+            while (table[slot] != empty && std::memcmp(&welded[table[slot]], &vertices[i], sizeof(Vertex)) != 0)
+                slot = (slot + 1) & (tableSize - 1);
+            if (table[slot] == empty)
+            {
+                table[slot] = (unsigned int)welded.size();
+                welded.push_back(vertices[i]);
+            }
+            remap[i] = table[slot];
+        }
+        for (unsigned int &index : indices)
+            index = remap[index];
+        vertices.swap(welded);
+    }
+
+    // Tom Forsyth, "Linear-Speed Vertex Cache Optimisation". greedily emits the triangle with the best score,
+    // where vertices score high when they are recently used or have few triangles left.
+    inline void OptimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount)
+    {
+        const int CacheSize = 32;
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0)
+            return;
+
+        auto vertexScore = [](int cachePosition, unsigned int remaining) {
+            if (remaining == 0)
+                return -1.0f;
+            float score = 0.0f;
+            if (cachePosition >= 0)
+                score = cachePosition < 3 ? 0.75f : std::pow(1.0f - (cachePosition - 3) / (float)(CacheSize - 3), 1.5f);
+            return score + 2.0f / std::sqrt((float)remaining);
+        };
+
+        // triangles adjacent to every vertex, as offsets into one array
+        std::vector<unsigned int> remaining(vertexCount, 0), offsets(vertexCount + 1, 0), adjacency(indices.size());
+        for (unsigned int index : indices)
+            remaining[index]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] = offsets[v] + remaining[v];
+        std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++)
+            for (int k = 0; k < 3; k++)
+                adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> scores(vertexCount);
+        std::vector<bool> emitted(triangleCount, false);
+        for (size_t v = 0; v < vertexCount; v++)
+            scores[v] = vertexScore(-1, remaining[v]);
+
+        std::vector<unsigned int> result;
+        result.reserve(indices.size());
+        std::vector<unsigned int> cache, nextCache;
+        size_t scanCursor = 0;
+        long best = -1;
+
+        while (result.size() < indices.size())
+        {
+            if (best < 0)
+            {
+                // nothing in the cache has triangles left: continue with the next unemitted one
+                while (emitted[scanCursor])
+                    scanCursor++;
+                best = (long)scanCursor;
+            }
+            const unsigned int *triangle = &indices[(size_t)best * 3];
+            emitted[(size_t)best] = true;
+            result.insert(result.end(), triangle, triangle + 3);
+
+            // drop the triangle from its vertices' adjacency lists
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int v = triangle[k];
+                unsigned int *begin = &adjacency[offsets[v]], *end = begin + remaining[v];
+                *std::find(begin, end, (unsigned int)best) = *(end - 1);
+                remaining[v]--;
+            }
+
+            // LRU: the triangle's vertices move to the front
+            nextCache.assign(triangle, triangle + 3);
+            for (unsigned int v : cache)
+                if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                    nextCache.push_back(v);
+            for (size_t i = 0; i < nextCache.size(); i++)
+            {
+                unsigned int v = nextCache[i];
+                cachePosition[v] = i < (size_t)CacheSize ? (int)i : -1;
+                scores[v] = vertexScore(cachePosition[v], remaining[v]);
+            }
+            if (nextCache.size() > (size_t)CacheSize)
+                nextCache.resize(CacheSize);
+            cache.swap(nextCache);
+
+            // rescore the triangles touching anything that moved, the best of them goes next
+            best = -1;
+            float bestScore = -1.0f;
+            for (unsigned int v : cache)
+            {
+                for (unsigned int a = offsets[v]; a < offsets[v] + remaining[v]; a++)
+                {
+                    unsigned int t = adjacency[a];
+                    float score = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+                    if (score > bestScore)
+                    {
+                        bestScore = score;
+                        best = (long)t;
+                    }
+                }
+            }
+        }
+        indices.swap(result);
+    }
+
+    // Splits the cache optimized order into clusters wherever the FIFO cache starts over (a triangle missing
+    // on all three vertices), then sorts the clusters front to back as seen from outside the mesh: clusters
+    // facing away from the mesh centre come first and occlude the inner ones. Cache efficiency inside the
+    // clusters is untouched, only a few misses at the new cluster seams are added.
+    inline void OptimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<Vertex> &vertices, unsigned int cacheSize = 16)
+    {
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0)
+            return;
+
+        std::vector<size_t> clusterStarts;
+        std::vector<size_t> timestamps(vertices.size(), 0);
+        size_t time = cacheSize + 1;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            int misses = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int index = indices[t * 3 + k];
+                if (time - timestamps[index] > cacheSize)
+                {
+                    timestamps[index] = time++;
+                    misses++;
+                }
+            }
+            if (t == 0 || misses == 3)
+                clusterStarts.push_back(t);
+        }
+        clusterStarts.push_back(triangleCount);
+        size_t clusterCount = clusterStarts.size() - 1;
+        if (clusterCount < 2)
+            return;
+
+        // area weighted centroid and normal per cluster
+        std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f)), normals(clusterCount, glm::vec3(0.0f));
+        std::vector<float> areas(clusterCount, 0.0f);
+        glm::vec3 meshCentroid(0.0f);
+        float meshArea = 0.0f;
+        for (size_t c = 0; c < clusterCount; c++)
+        {
+            for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+            {
+                const glm::vec3 &p0 = vertices[indices[t * 3]].Position;
+                const glm::vec3 &p1 = vertices[indices[t * 3 + 1]].Position;
+                const glm::vec3 &p2 = vertices[indices[t * 3 + 2]].Position;
+                glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                float area = glm::length(normal);
+                centroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+                normals[c] += normal;
+                areas[c] += area;
+            }
+            meshCentroid += centroids[c];
+            meshArea += areas[c];
+            if (areas[c] > 0.0f)
+                centroids[c] /= areas[c];
+        }
+        if (meshArea > 0.0f)
+            meshCentroid /= meshArea;
+
+        std::vector<float> sortKeys(clusterCount);
+        std::vector<size_t> order(clusterCount);
+        for (size_t c = 0; c < clusterCount; c++)
+        {
+            float length = glm::length(normals[c]);
+            sortKeys[c] = length > 0.0f ? glm::dot(centroids[c] - meshCentroid, normals[c] / length) : 0.0f;
+            order[c] = c;
+        }
+        std::stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+        std::vector<unsigned int> result;
+        result.reserve(indices.size());
+        for (size_t c : order)
+            result.insert(result.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+        indices.swap(result);
+    }
+
+    // renumbers vertices in order of first use; unreferenced vertices are dropped
+    inline void OptimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+    {
+        const unsigned int unused = ~0u;
+        std::vector<unsigned int> remap(vertices.size(), unused);
+        std::vector<Vertex> reordered;
+        reordered.reserve(vertices.size());
+        for (unsigned int &index : indices)
+        {
+            if (remap[index] == unused)
+            {
+                remap[index] = (unsigned int)reordered.size();
+                reordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices.swap(reordered);
+    }
+
+    // totals over every mesh of a model, for the import log
+    struct Stats {
+        size_t triangles = 0;
+        size_t importedVertices = 0, optimizedVertices = 0;
+        size_t importedMisses = 0, weldedMisses = 0, optimizedMisses = 0;
+    };
+
+    // runs the whole pipeline on a freshly imported mesh
+    inline void Optimize(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, Stats &stats)
+    {
+        stats.triangles += indices.size() / 3;
+        stats.importedVertices += vertices.size();
+        stats.importedMisses += CacheMisses(indices, vertices.size());
+
+        WeldVertices(vertices, indices);
+        stats.weldedMisses += CacheMisses(indices, vertices.size());
+
+        OptimizeVertexCache(indices, vertices.size());
+        OptimizeOverdraw(indices, vertices);
+        OptimizeVertexFetch(vertices, indices);
+        stats.optimizedVertices += vertices.size();
+        stats.optimizedMisses += CacheMisses(indices, vertices.size());
+    }
+}
+
+#endif
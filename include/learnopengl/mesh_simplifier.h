@@ -0,0 +1,231 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_optimizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+// Quadric error metric simplification (Garland & Heckbert) used to build the LOD chain of a mesh at import.
+// Edges are collapsed onto one of their existing vertices, so every LOD is just another index list over the
+// original vertex buffer. Vertices on open borders and attribute seams (UV / normal splits show up as borders
+// in the index topology) are never moved, which keeps LODs crack free at the cost of simplifying less there.
+namespace MeshSimplifier {
+
+    // symmetric 4x4 matrix, upper triangle: sum of squared distances to a set of planes
+    struct Quadric {
+        double a[10] = {};
+
+        Quadric &operator+=(const Quadric &other)
+        {
+            for (int i = 0; i < 10; i++)
+                a[i] += other.a[i];
+            return *this;
+        }
+
+        static Quadric Plane(double x, double y, double z, double w)
+        {
+            Quadric q;
+            q.a[0] = x * x; q.a[1] = x * y; q.a[2] = x * z; q.a[3] = x * w;
+            q.a[4] = y * y; q.a[5] = y * z; q.a[6] = y * w;
+            q.a[7] = z * z; q.a[8] = z * w;
+            q.a[9] = w * w;
+            return q;
+        }
+
+        double Error(const glm::vec3 &p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            double error = a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x
+                         + a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y
+                         + a[7] * z * z + 2 * a[8] * z
+                         + a[9];
+            return std::max(0.0, error);
+        }
+    };
+
+    // reduces a triangle list to at most 'targetIndexCount' indices (or as far as it gets). 'error' receives the
+    // largest collapse error, roughly the distance the surface moved, in model units.
+    inline std::vector<unsigned int> Simplify(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
+                                              size_t targetIndexCount, float &error)
+    {
+        size_t vertexCount = vertices.size(), triangleCount = indices.size() / 3;
+        std::vector<unsigned int> triangles(indices);
+        std::vector<bool> triangleRemoved(triangleCount, false);
+        std::vector<Quadric> quadrics(vertexCount);
+        std::vector<std::vector<unsigned int>> vertexTriangles(vertexCount);
+        std::unordered_map<uint64_t, unsigned int> edgeUses;
+
+        auto edgeKey = [](unsigned int a, unsigned int b) {
+            return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+        };
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            const unsigned int *triangle = &triangles[t * 3];
+            const glm::vec3 &p0 = vertices[triangle[0]].Position;
+            glm::vec3 normal = glm::cross(vertices[triangle[1]].Position - p0, vertices[triangle[2]].Position - p0);
+            float length = glm::length(normal);
+            if (length > 0.0f)
+            {
+                normal /= length;
+                Quadric plane = Quadric::Plane(normal.x, normal.y, normal.z, -glm::dot(normal, p0));
+                for (int k = 0; k < 3; k++)
+                    quadrics[triangle[k]] += plane;
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                vertexTriangles[triangle[k]].push_back((unsigned int)t);
+                edgeUses[edgeKey(triangle[k], triangle[(k + 1) % 3])]++;
+            }
+        }
+        std::vector<bool> locked(vertexCount, false);
+        for (const auto &edge : edgeUses)
+        {
+            if (edge.second == 1)
+            {
+                locked[edge.first >> 32] = true;
+                locked[edge.first & 0xFFFFFFFF] = true;
+            }
+        }
+
+        struct Collapse {
+            double cost;
+            unsigned int from, to;
+            unsigned int fromVersion, toVersion;
+            bool operator<(const Collapse &other) const { return cost > other.cost; } // min heap
+        };
+        std::vector<unsigned int> version(vertexCount, 0);
+        std::vector<bool> removed(vertexCount, false);
+        std::priority_queue<Collapse> heap;
+        auto push = [&](unsigned int from, unsigned int to) {
+            if (locked[from])
+                return;
+            Quadric sum = quadrics[from];
+            sum += quadrics[to];
+            heap.push({ sum.Error(vertices[to].Position), from, to, version[from], version[to] });
+        };
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                push(triangles[t * 3 + k], triangles[t * 3 + (k + 1) % 3]);
+                push(triangles[t * 3 + (k + 1) % 3], triangles[t * 3 + k]);
+            }
+        }
+
+        // moving 'from' onto 'to' must not flip any of the triangles that stay
+        auto flips = [&](unsigned int from, unsigned int to) {
+            for (unsigned int t : vertexTriangles[from])
+            {
+                if (triangleRemoved[t])
+                    continue;
+                const unsigned int *triangle = &triangles[t * 3];
+                if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+                    continue;
+                glm::vec3 before[3], after[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    before[k] = vertices[triangle[k]].Position;
+                    after[k] = triangle[k] == from ? vertices[to].Position : before[k];
+                }
+                glm::vec3 oldNormal = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 newNormal = glm::cross(after[1] - after[0], after[2] - after[0]);
+                if (glm::dot(oldNormal, newNormal) <= 0.0f)
+                    return true;
+            }
+            return false;
+        };
+
+        double maxCost = 0.0;
+        size_t liveIndexCount = indices.size();
+        while (liveIndexCount > targetIndexCount && !heap.empty())
+        {
+            Collapse collapse = heap.top();
+            heap.pop();
+            unsigned int from = collapse.from, to = collapse.to;
+            if (removed[from] || removed[to] || version[from] != collapse.fromVersion || version[to] != collapse.toVersion)
+                continue;
+            if (flips(from, to))
+                continue;
+
+            for (unsigned int t : vertexTriangles[from])
+            {
+                if (triangleRemoved[t])
+                    continue;
+                unsigned int *triangle = &triangles[t * 3];
+                if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+                {
+                    triangleRemoved[t] = true;
+                    liveIndexCount -= 3;
+                    continue;
+                }
+                for (int k = 0; k < 3; k++)
+                    if (triangle[k] == from)
+                        triangle[k] = to;
+                vertexTriangles[to].push_back(t);
+            }
+            vertexTriangles[from].clear();
+            quadrics[to] += quadrics[from];
+            removed[from] = true;
+            version[to]++;
+            maxCost = std::max(maxCost, collapse.cost);
+
+            // drop dead triangles from the survivor's list and queue its new edges
+            std::vector<unsigned int> &around = vertexTriangles[to];
+            around.erase(std::remove_if(around.begin(), around.end(), [&](unsigned int t) { return triangleRemoved[t]; }), around.end());
+            for (unsigned int t : around)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    unsigned int other = triangles[t * 3 + k];
+                    if (other == to)
+                        continue;
+                    push(other, to);
+                    push(to, other);
+                }
+            }
+        }
+
+        std::vector<unsigned int> result;
+        result.reserve(liveIndexCount);
+        for (size_t t = 0; t < triangleCount; t++)
+            if (!triangleRemoved[t])
+                result.insert(result.end(), &triangles[t * 3], &triangles[t * 3] + 3);
+        error = (float)std::sqrt(maxCost);
+        return result;
+    }
+
+    const unsigned int MaxLods = 4;
+
+    // Appends LOD 1..n behind the LOD 0 indices in 'indices', each about half the triangles of the previous
+    // one, and returns the ranges. LOD errors accumulate, so a level's error bounds its distance to LOD 0.
+    // The chain stops early once a mesh doesn't simplify any further (mostly seams and borders left).
+    inline std::vector<MeshLod> BuildLodChain(const std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+    {
+        std::vector<MeshLod> lods;
+        lods.push_back({ 0, (uint32_t)indices.size(), 0.0f });
+        std::vector<unsigned int> current(indices);
+        while (lods.size() < MaxLods)
+        {
+            size_t target = current.size() / 6 * 3;
+            if (target < 3 * 32)
+                break;
+            float error;
+            std::vector<unsigned int> next = Simplify(vertices, current, target, error);
+            if (next.size() * 5 > current.size() * 4)
+                break;
+            MeshOptimizer::OptimizeVertexCache(next, vertices.size());
+            lods.push_back({ (uint32_t)indices.size(), (uint32_t)next.size(), lods.back().error + error });
+            indices.insert(indices.end(), next.begin(), next.end());
+            current.swap(next);
+        }
+        return lods;
+    }
+}
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef MESHLET_BUILDER_H
+#define MESHLET_BUILDER_H
+
+#include <learnopengl/mesh.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// Splits LOD 0 of a mesh into meshlets at import, so large meshes can be culled piece by piece. A meshlet grows
+// greedily from a seed triangle over shared vertices, preferring triangles that add no new vertex and face the
+// way the meshlet already does; it stops at MaxTriangles or MaxVertices, or when no neighbour faces less than
+// 90 degrees away. Tight normal cones are what lets whole back facing meshlets be rejected.
+//
+// The LOD 0 index range is rewritten meshlet by meshlet, triangles inside a meshlet keep their vertex cache
+// order. Lower LODs are left alone, they are drawn whole.
+namespace MeshletBuilder {
+
+    const unsigned int MaxTriangles = 124, MaxVertices = 64;
+
+    inline glm::vec3 TriangleNormal(const std::vector<Vertex> &vertices, const unsigned int *triangle)
+    {
+        glm::vec3 normal = glm::cross(vertices[triangle[1]].Position - vertices[triangle[0]].Position,
+                                      vertices[triangle[2]].Position - vertices[triangle[0]].Position);
+        float length = glm::length(normal);
+        return length > 0.0f ? normal / length : glm::vec3(0.0f);
+    }
+
+    // bounding sphere and normal cone of the triangles in 'indices'
+    inline void ComputeBounds(const std::vector<Vertex> &vertices, const unsigned int *indices, size_t indexCount, Meshlet &meshlet)
+    {
+        Bounds box;
+        glm::vec3 normalSum(0.0f);
+        for (size_t i = 0; i < indexCount; i++)
+            box.Add(vertices[indices[i]].Position);
+        for (size_t i = 0; i < indexCount; i += 3)
+            normalSum += TriangleNormal(vertices, indices + i);
+        meshlet.center = box.Center();
+        meshlet.radius = 0.0f;
+        for (size_t i = 0; i < indexCount; i++)
+            meshlet.radius = std::max(meshlet.radius, glm::length(vertices[indices[i]].Position - meshlet.center));
+
+        // the cutoff is the sine of the cone's half angle: a meshlet is back facing when its center direction
+        // lies more than that beyond 90 degrees of the axis, see RenderQueue
+        float length = glm::length(normalSum);
+        meshlet.coneAxis = length > 0.0f ? normalSum / length : glm::vec3(0.0f, 0.0f, 1.0f);
+        meshlet.coneCutoff = 1.0f;
+        if (length <= 0.0f)
+            return;
+        float minimumDot = 1.0f;
+        for (size_t i = 0; i < indexCount; i += 3)
+        {
+            glm::vec3 normal = TriangleNormal(vertices, indices + i);
+            if (normal != glm::vec3(0.0f))
+                minimumDot = std::min(minimumDot, glm::dot(normal, meshlet.coneAxis));
+        }
+        if (minimumDot > 0.0f)
+            meshlet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+    }
+
+    // partitions the triangles of 'lod' into meshlets and reorders its range of 'indices' to match
+    inline std::vector<Meshlet> Build(const std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, const MeshLod &lod)
+    {
+        std::vector<Meshlet> meshlets;
+        size_t triangleCount = lod.indexCount / 3;
+        if (triangleCount == 0)
+            return meshlets;
+        std::vector<unsigned int> source(indices.begin() + lod.indexOffset, indices.begin() + lod.indexOffset + triangleCount * 3);
+
+        // triangles adjacent to every vertex, as offsets into one array
+        std::vector<unsigned int> offsets(vertices.size() + 1, 0), adjacency(source.size());
+        for (unsigned int index : source)
+            offsets[index + 1]++;
+        for (size_t v = 0; v < vertices.size(); v++)
+            offsets[v + 1] += offsets[v];
+        std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++)
+            for (int k = 0; k < 3; k++)
+                adjacency[fill[source[t * 3 + k]]++] = (unsigned int)t;
+
+        std::vector<glm::vec3> normals(triangleCount);
+        for (size_t t = 0; t < triangleCount; t++)
+            normals[t] = TriangleNormal(vertices, &source[t * 3]);
+
+        // per meshlet stamps instead of sets: a vertex or candidate belongs to the current meshlet when its stamp is
+        // the meshlet's number
+        const unsigned int none = std::numeric_limits<unsigned int>::max();
+        std::vector<unsigned int> vertexStamp(vertices.size(), none), candidateStamp(triangleCount, none);
+        std::vector<bool> assigned(triangleCount, false);
+        std::vector<unsigned int> members, candidates, reordered;
+        reordered.reserve(source.size());
+        size_t seed = 0;
+        while (true)
+        {
+            while (seed < triangleCount && assigned[seed])
+                seed++;
+            if (seed == triangleCount)
+                break;
+            unsigned int stamp = (unsigned int)meshlets.size();
+            unsigned int vertexCount = 0;
+            glm::vec3 normalSum(0.0f);
+            members.clear();
+            candidates.clear();
+            auto add = [&](unsigned int triangle) {
+                assigned[triangle] = true;
+                members.push_back(triangle);
+                normalSum += normals[triangle];
+                for (int k = 0; k < 3; k++)
+                {
+                    unsigned int v = source[triangle * 3 + k];
+                    if (vertexStamp[v] != stamp)
+                    {
+                        vertexStamp[v] = stamp;
+                        vertexCount++;
+                    }
+                    for (unsigned int i = offsets[v]; i < offsets[v + 1]; i++)
+                        if (!assigned[adjacency[i]] && candidateStamp[adjacency[i]] != stamp)
+                        {
+                            candidateStamp[adjacency[i]] = stamp;
+                            candidates.push_back(adjacency[i]);
+                        }
+                }
+            };
+            add((unsigned int)seed);
+
+            while (members.size() < MaxTriangles)
+            {
+                glm::vec3 axis = glm::length(normalSum) > 0.0f ? glm::normalize(normalSum) : glm::vec3(0.0f);
+                long best = -1;
+                float bestScore = -std::numeric_limits<float>::max();
+                for (size_t i = 0; i < candidates.size();)
+                {
+                    unsigned int triangle = candidates[i];
+                    if (assigned[triangle])
+                    {
+                        candidates[i] = candidates.back();
+                        candidates.pop_back();
+                        continue;
+                    }
+                    i++;
+                    unsigned int newVertices = 0;
+                    for (int k = 0; k < 3; k++)
+                        newVertices += vertexStamp[source[triangle * 3 + k]] != stamp ? 1 : 0;
+                    float facing = glm::dot(normals[triangle], axis);
+                    if (vertexCount + newVertices > MaxVertices || facing < 0.0f)
+                        continue;
+                    float score = facing - 0.5f * newVertices;
+                    if (score > bestScore)
+                    {
+                        bestScore = score;
+                        best = (long)triangle;
+                    }
+                }
+                if (best < 0)
+                    break;
+                add((unsigned int)best);
+            }
+
+            // the original order within the meshlet is the vertex cache friendly one
+            std::sort(members.begin(), members.end());
+            Meshlet meshlet;
+            meshlet.indexOffset = lod.indexOffset + (uint32_t)reordered.size();
+            meshlet.indexCount = (uint32_t)members.size() * 3;
+            for (unsigned int triangle : members)
+                reordered.insert(reordered.end(), &source[triangle * 3], &source[triangle * 3] + 3);
+            ComputeBounds(vertices, &reordered[meshlet.indexOffset - lod.indexOffset], meshlet.indexCount, meshlet);
+            meshlets.push_back(meshlet);
+        }
+        std::copy(reordered.begin(), reordered.end(), indices.begin() + lod.indexOffset);
+        return meshlets;
+    }
+}
+
+#endif
@@ -10,52 +10,225 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <learnopengl/asset_registry.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/mesh_simplifier.h>
+#include <learnopengl/meshlet_builder.h>
+#include <learnopengl/occlusion_culler.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture_streamer.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <limits>
 #include <map>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// result of the CPU side of model loading (file parsing, vertex conversion, index flattening).
+// it contains no GL objects, so it can be produced on a worker thread and handed to Model on the GL thread.
+struct ModelData
+{
+    string key; // asset registry key: canonical path + content hash of the source
+    string directory;
+    vector<MeshData> meshes;
+    // material texture path -> asset registry key, hashed on the worker so the GL thread only does lookups
+    std::unordered_map<string, string> textureKeys;
+    // keeps the cooked cache file mapped while the meshes point into it
+    std::shared_ptr<MappedFile> cacheFile;
+};
+
+
+// what LOD selection needs to know about the camera
+struct LodView
+{
+    glm::vec3 cameraPosition;
+    float projectionScale; // turns size / distance into pixels: projection[1][1] * viewport height / 2
+    float pixelError;      // largest acceptable geometric error on screen, in pixels
+};
 
 
 class Model
 {
 public:
     // model data
-    vector<Texture> textures_loaded;	// stores all the FinalTextures loaded so far, optimization to make sure FinalTextures aren't loaded more than once.
-    vector<Mesh>    meshes;
+    vector<Mesh>    meshes;	// handles to the meshes shared through the asset registry, one copy per model so per model state stays separate
     string directory;
     bool gammaCorrection;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const &path, bool gamma = false) : gammaCorrection(gamma), textureStreamer(nullptr)
+    {
+        setupModel(*Import(path));
+    }
+
+    // constructor, expects the result of Import (possibly run on another thread). must be called on the GL thread.
+    // with a texture streamer the material textures are decoded in the background instead of right here.
+    explicit Model(ModelData const &data, TextureStreamer *textureStreamer = nullptr, bool gamma = false)
+            : gammaCorrection(gamma), textureStreamer(textureStreamer)
+    {
+        setupModel(data);
+    }
+
+    // loads a model with supported ASSIMP extensions from file into CPU memory. touches no GL state and is safe to
+    // call from worker threads. a cooked copy of the meshes is kept in the mesh cache so later runs can skip ASSIMP entirely.
+    // imports of the same file are shared through the asset registry, concurrent ones included.
+    static std::shared_ptr<const ModelData> Import(string const &path)
+    {
+        uint64_t sourceHash = MeshCache::HashSource(path);
+        string key = AssetRegistry::FileKey(path, sourceHash);
+        return AssetRegistry::Instance().AcquireOnce<ModelData>("model data", key, [&]() {
+            return importFile(path, sourceHash, key);
+        });
+    }
+
+    // picks the level of detail for this frame from the model's projected size: the coarsest level whose error
+    // covers at most view.pixelError pixels on screen
+    void SelectLod(const glm::mat4 &model, const LodView &view)
+    {
+        instanceLods.clear();
+        if (!lodErrors.empty())
+            setLod(lodFor(model, view, activeLod));
+    }
+
+    // same for a model drawn instanced: every instance gets its own level, see InstanceLod(). the model's own
+    // level, the one the meshes are left at, is the finest of them.
+    void SelectLod(const glm::mat4 *models, size_t count, const LodView &view)
+    {
+        instanceLods.resize(count, activeLod);
+        if (lodErrors.empty() || count == 0)
+            return;
+        unsigned int finest = (unsigned int)lodErrors.size() - 1;
+        for (size_t i = 0; i < count; i++)
+        {
+            instanceLods[i] = lodFor(models[i], view, instanceLods[i]);
+            finest = std::min(finest, instanceLods[i]);
+        }
+        setLod(finest);
+    }
+
+    // the level picked for instance 'i' by the last instanced SelectLod(), the model's level otherwise
+    unsigned int InstanceLod(size_t i) const { return i < instanceLods.size() ? instanceLods[i] : activeLod; }
+
+    // bounding box of all meshes and the sphere around it, in model space
+    const Bounds &ModelBounds() const { return bounds; }
+    glm::vec3 BoundsCenter() const { return bounds.Center(); }
+    float BoundsRadius() const { return bounds.Radius(); }
+
+    // the model for the software occlusion culler, see setupOccluder
+    const OccluderProxy &Occluder() const { return occluder; }
+
+    // whether the scene shaders have to alpha test the model. they do until the texture streamer has uploaded
+    // every texture the meshes sample as diffuse and none of them has alpha; models loaded without the
+    // streamer always do.
+    bool AlphaTested()
     {
-        loadModel(path);
+        if (provenOpaque)
+            return false;
+        if (!textureStreamer)
+            return true;
+        for (const Mesh &mesh : meshes)
+        {
+            // see Material::For: without a diffuse texture the sampler reads the mesh's first texture
+            const Texture *diffuse = mesh.textures.empty() ? nullptr : &mesh.textures.front();
+            for (const Texture &texture : mesh.textures)
+                if (texture.type == "texture_diffuse")
+                {
+                    diffuse = &texture;
+                    break;
+                }
+            if (diffuse && !textureStreamer->Opaque(diffuse->id))
+                return true;
+        }
+        provenOpaque = true;
+        return false;
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader &shader)
+    unsigned int ActiveLod() const { return activeLod; }
+    unsigned int LodCount() const { return (unsigned int)std::max<size_t>(lodErrors.size(), 1); }
+
+    unsigned int TriangleCount() const
     {
-        for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+        unsigned int triangles = 0;
+        for (const Mesh &mesh : meshes)
+            triangles += mesh.TriangleCount();
+        return triangles;
     }
 
+    // a Model has no draw call of its own: its per object data lives in ObjectBlocks, so models are drawn by
+    // handing them to RenderQueue::Submit() or SubmitInstanced() with their transforms (and tints).
+
     void SetShaderTextureNamePrefix(std::string prefix) {
         for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
+            mesh.SetTextureNamePrefix(prefix);
         }
     }
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+    TextureStreamer *textureStreamer;
+    bool provenOpaque = false; // see AlphaTested()
+    // keeps the registry entry for this model's meshes alive
+    std::shared_ptr<vector<Mesh>> sharedMeshes;
+    Bounds bounds; // in model space
+    OccluderProxy occluder;
+    // per level: the largest error of any mesh, meshes with shorter chains stay at their last level
+    vector<float> lodErrors;
+    unsigned int activeLod = 0;
+    vector<unsigned int> instanceLods; // of the last instanced SelectLod(), each instance's own hysteresis
+
+    // the level SelectLod() would pick for 'model', currently drawn at 'current'
+    unsigned int lodFor(const glm::mat4 &model, const LodView &view, unsigned int current) const
+    {
+        // a coarser level is only taken once it is this much below the threshold, so LODs don't flicker at the boundary
+        const float hysteresis = 0.25f;
+        glm::vec3 center = glm::vec3(model * glm::vec4(BoundsCenter(), 1.0f));
+        float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        // distance to the nearest point of the bounding sphere, inside it everything is full detail
+        float distance = glm::length(center - view.cameraPosition) - BoundsRadius() * scale;
+        if (distance <= 0.0f)
+            return 0;
+        float pixelsPerUnit = view.projectionScale * scale / distance;
+
+        unsigned int lod = current;
+        while (lod > 0 && lodErrors[lod] * pixelsPerUnit > view.pixelError)
+            lod--;
+        while (lod + 1 < lodErrors.size() && lodErrors[lod + 1] * pixelsPerUnit < view.pixelError * (1.0f - hysteresis))
+            lod++;
+        return lod;
+    }
+
+    void setLod(unsigned int lod)
     {
+        activeLod = lod;
+        for (Mesh &mesh : meshes)
+            mesh.activeLod = std::min(lod, (unsigned int)mesh.lods.size() - 1);
+    }
+
+    // the actual import behind Import: cooked cache if it is up to date, ASSIMP otherwise
+    static ModelData importFile(string const &path, uint64_t sourceHash, string const &key)
+    {
+        ModelData data;
+        data.key = key;
+        // retrieve the directory path of the filepath
+        data.directory = path.substr(0, path.find_last_of('/'));
+
+        // warm start: map the cooked file and upload straight from it
+        string cachePath = MeshCache::PathFor(path);
+        data.cacheFile = std::make_shared<MappedFile>();
+        if (MeshCache::Load(cachePath, sourceHash, *data.cacheFile, data.meshes))
+        {
+            hashTextures(data);
+            return data;
+        }
+        data.cacheFile.reset();
+
         // read file via ASSIMP
         Assimp::Importer importer;
         const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
@@ -63,17 +236,116 @@ private:
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            return data;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        processNode(scene->mRootNode, scene, data.meshes);
+        optimizeMeshes(path, data.meshes);
+
+        if (!MeshCache::Store(cachePath, sourceHash, data.meshes))
+            cout << "WARNING::MESH_CACHE:: could not write " << cachePath << endl;
+        hashTextures(data);
+        return data;
+    }
+
+    // vertex cache / overdraw / fetch optimization, done once here so both the live path and the cache get it
+    static void optimizeMeshes(string const &path, vector<MeshData> &meshes)
+    {
+        MeshOptimizer::Stats stats;
+        size_t lodTriangles[MeshSimplifier::MaxLods] = {};
+        size_t meshletCount = 0;
+        for (MeshData &mesh : meshes)
+        {
+            MeshOptimizer::Optimize(mesh.vertices, mesh.indices, stats);
+            mesh.lods = MeshSimplifier::BuildLodChain(mesh.vertices, mesh.indices);
+            mesh.meshlets = MeshletBuilder::Build(mesh.vertices, mesh.indices, mesh.lods[0]);
+            meshletCount += mesh.meshlets.size();
+            for (size_t lod = 0; lod < MeshSimplifier::MaxLods; lod++)
+                lodTriangles[lod] += mesh.lods[std::min(lod, mesh.lods.size() - 1)].indexCount / 3;
+        }
+        if (stats.triangles == 0)
+            return;
+        float triangles = (float)stats.triangles;
+        cout << "Optimized " << path << ": " << stats.importedVertices << " -> " << stats.optimizedVertices << " vertices, ACMR "
+             << stats.importedMisses / triangles << " (imported) " << stats.weldedMisses / triangles << " (welded) -> "
+             << stats.optimizedMisses / triangles << ", LOD triangles";
+        for (size_t triangles : lodTriangles)
+            cout << ' ' << triangles;
+        cout << ", " << meshletCount << " meshlets" << endl;
+    }
+
+    static void hashTextures(ModelData &data)
+    {
+        for (const MeshData &mesh : data.meshes)
+            for (const Texture &texture : mesh.textures)
+                if (data.textureKeys.find(texture.path) == data.textureKeys.end())
+                    data.textureKeys[texture.path] = AssetRegistry::FileKey(data.directory + '/' + texture.path);
+    }
+
+    // creates the GL side of the model: textures and the vertex/index buffers of every mesh.
+    // a model whose source is already loaded (e.g. the second eyeball) just shares the existing meshes.
+    void setupModel(ModelData const &data)
+    {
+        directory = data.directory;
+        sharedMeshes = AssetRegistry::Instance().Acquire<vector<Mesh>>("meshes", data.key, [&]() {
+            auto created = std::make_shared<vector<Mesh>>();
+            created->reserve(data.meshes.size());
+            for (const MeshData &meshData : data.meshes)
+            {
+                vector<Texture> textures;
+                for (const Texture &texture : meshData.textures)
+                    textures.push_back(loadTexture(data, texture.path, texture.type));
+                created->push_back(Mesh(meshData.vertexData(), meshData.vertexCount(), meshData.indexData(), meshData.indexCount(), textures, meshData.lods, meshData.meshlets));
+            }
+            return created;
+        });
+        meshes = *sharedMeshes;
+
+        for (const Mesh &mesh : meshes)
+            bounds.Add(mesh.bounds);
+        for (const MeshData &meshData : data.meshes)
+            lodErrors.resize(std::max(lodErrors.size(), meshData.lods.size()), 0.0f);
+        // a mesh with a shorter chain keeps being drawn at its last level, so that level's error counts for the later ones
+        for (const MeshData &meshData : data.meshes)
+            for (size_t lod = 0; lod < lodErrors.size() && !meshData.lods.empty(); lod++)
+                lodErrors[lod] = std::max(lodErrors[lod], meshData.lods[std::min(lod, meshData.lods.size() - 1)].error);
+        setupOccluder(data);
+    }
+
+    // The occluder proxy is the coarsest level of every mesh that is still within 1% of the model's size of the
+    // real surface; a coarser one could cover things that are actually visible. Only the vertices that level
+    // uses are kept, each moved back along its normal by the level's error so the proxy stays behind the surface.
+    void setupOccluder(ModelData const &data)
+    {
+        const float maximumError = bounds.Radius() * 0.01f;
+        for (const MeshData &meshData : data.meshes)
+        {
+            if (meshData.lods.empty())
+                continue;
+            size_t level = 0;
+            while (level + 1 < meshData.lods.size() && meshData.lods[level + 1].error <= maximumError)
+                level++;
+            const MeshLod &lod = meshData.lods[level];
+            const Vertex *vertices = meshData.vertexData();
+            const unsigned int *indices = meshData.indexData() + lod.indexOffset;
+            vector<uint32_t> remap(meshData.vertexCount(), ~0u);
+            for (uint32_t i = 0; i < lod.indexCount; i++)
+            {
+                uint32_t &mapped = remap[indices[i]];
+                if (mapped == ~0u)
+                {
+                    mapped = (uint32_t)occluder.positions.size();
+                    const Vertex &vertex = vertices[indices[i]];
+                    occluder.positions.push_back(vertex.Position - vertex.Normal * lod.error);
+                }
+                occluder.indices.push_back(mapped);
+            }
+        }
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    static void processNode(aiNode *node, const aiScene *scene, vector<MeshData> &meshes)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -86,22 +358,25 @@ private:
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, meshes);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        MeshData data;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        vector<Texture> &textures = data.textures;
+        vertices.reserve(mesh->mNumVertices);
+        indices.reserve(mesh->mNumFaces * 3);
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
+            Vertex vertex = {};
             glm::vec3 vector; // we declare a placeholder vector since assimp_ uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
             // positions
             vector.x = mesh->mVertices[i].x;
@@ -178,42 +453,51 @@ private:
 
 
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // return the extracted mesh data, GL objects are created later on the context thread
+        return data;
     }
 
-    // checks all material FinalTextures of a given type and loads the FinalTextures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // collects all material textures of a given type. only path and type are filled in here,
+    // the textures themselves are loaded (once per model) when the GL side of the model is set up.
+    static vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
     {
         vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory,true);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate FinalTextures.
-            }
+            Texture texture;
+            texture.id = 0;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
         }
         return textures;
     }
+
+    // returns the texture with the given path relative to the model directory. textures are shared process wide
+    // through the asset registry, so every file is only loaded once no matter how many meshes and models use it.
+    Texture loadTexture(ModelData const &data, string const &path, string const &typeName)
+    {
+        auto key = data.textureKeys.find(path);
+        string textureKey = key != data.textureKeys.end() ? key->second : AssetRegistry::FileKey(directory + '/' + path);
+
+        // normal maps compress differently, so the same file used as both is two textures
+        bool normalMap = typeName == "texture_normal";
+        Texture texture;
+        texture.object = AssetRegistry::Instance().Acquire<TextureObject>(normalMap ? "normal map" : "texture", textureKey, [&]() {
+            unsigned int id;
+            if (textureStreamer)
+                id = textureStreamer->Request(this->directory + '/' + path, normalMap);
+            else
+                id = TextureFromFile(path.c_str(), this->directory, true);
+            return std::make_shared<TextureObject>(id);
+        });
+        texture.id = texture.object->id;
+        texture.type = typeName;
+        texture.path = path;
+        return texture;
+    }
 };
 
 
@@ -0,0 +1,227 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/bounds.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#ifdef BOUNDS_SSE
+#include <emmintrin.h>
+#endif
+
+// a simplified copy of a model's surface, in model space, for the software rasterizer
+struct OccluderProxy {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+};
+
+// Software occlusion culling on the CPU. Large occluders (simplified proxies of them) are rasterized into a
+// small depth buffer, 4 pixels at a time with SSE, and the buffer is reduced to the farthest depth of every
+// 8x8 tile. An occludee's screen rectangle and nearest depth are then checked against the tiles it covers: it
+// is hidden when every tile is closer than its nearest point. Nothing here touches GL, so it runs and can be
+// tested without a context and never waits on the GPU.
+//
+// Both sides stay conservative: occluder triangles crossing the near plane are dropped, and an occludee with a
+// corner in front of it counts as visible. Proxies are only conservative if they never stick out of the real
+// surface; Model::setupOccluder pushes them back by their simplification error.
+class OcclusionCuller {
+public:
+    static const int Width = 256, Height = 144, TileSize = 8;
+    static const int TilesX = Width / TileSize, TilesY = Height / TileSize;
+
+    OcclusionCuller() : depth(Width * Height, 1.0f), tiles(TilesX * TilesY, 1.0f) {}
+
+    // starts a frame: empties the depth buffer, everything is drawn with 'viewProjection'
+    void Clear(const glm::mat4 &viewProjection)
+    {
+        this->viewProjection = viewProjection;
+        std::fill(depth.begin(), depth.end(), 1.0f);
+        std::fill(tiles.begin(), tiles.end(), 1.0f);
+        triangles = 0;
+    }
+
+    void RenderOccluder(const OccluderProxy &proxy, const glm::mat4 &model)
+    {
+        glm::mat4 transform = viewProjection * model;
+        screen.resize(proxy.positions.size());
+        for (size_t i = 0; i < proxy.positions.size(); i++)
+        {
+            glm::vec4 clip = transform * glm::vec4(proxy.positions[i], 1.0f);
+            // a vertex in front of the near plane marks its triangles as unusable
+            if (nearClipped(clip))
+            {
+                screen[i] = glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+                continue;
+            }
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            screen[i] = glm::vec4((ndc.x * 0.5f + 0.5f) * Width, (ndc.y * 0.5f + 0.5f) * Height, ndc.z * 0.5f + 0.5f, 1.0f);
+        }
+        for (size_t i = 0; i + 2 < proxy.indices.size(); i += 3)
+        {
+            const glm::vec4 &a = screen[proxy.indices[i]], &b = screen[proxy.indices[i + 1]], &c = screen[proxy.indices[i + 2]];
+            if (a.w < 0.0f || b.w < 0.0f || c.w < 0.0f)
+                continue;
+            rasterize(a, b, c);
+        }
+    }
+
+    // call after the last occluder, before testing
+    void BuildHierarchy()
+    {
+        for (int ty = 0; ty < TilesY; ty++)
+            for (int tx = 0; tx < TilesX; tx++)
+            {
+                const float *row = &depth[ty * TileSize * Width + tx * TileSize];
+#ifdef BOUNDS_SSE
+                __m128 farthest = _mm_setzero_ps();
+                for (int y = 0; y < TileSize; y++, row += Width)
+                    farthest = _mm_max_ps(farthest, _mm_max_ps(_mm_loadu_ps(row), _mm_loadu_ps(row + 4)));
+                farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(1, 0, 3, 2)));
+                farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(2, 3, 0, 1)));
+                tiles[ty * TilesX + tx] = _mm_cvtss_f32(farthest);
+#else
+                float farthest = 0.0f;
+                for (int y = 0; y < TileSize; y++, row += Width)
+                    for (int x = 0; x < TileSize; x++)
+                        farthest = std::max(farthest, row[x]);
+                tiles[ty * TilesX + tx] = farthest;
+#endif
+            }
+    }
+
+    // false only when the box, moved by 'model', is certainly behind the occluders
+    bool Visible(const Bounds &box, const glm::mat4 &model) const
+    {
+        if (box.Empty())
+            return false;
+        glm::mat4 transform = viewProjection * model;
+        glm::vec2 low(std::numeric_limits<float>::max()), high(-std::numeric_limits<float>::max());
+        float nearest = 1.0f;
+        for (int corner = 0; corner < 8; corner++)
+        {
+            glm::vec3 point((corner & 1) ? box.maximum.x : box.minimum.x, (corner & 2) ? box.maximum.y : box.minimum.y,
+                            (corner & 4) ? box.maximum.z : box.minimum.z);
+            glm::vec4 clip = transform * glm::vec4(point, 1.0f);
+            if (nearClipped(clip))
+                return true;
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            glm::vec2 pixel((ndc.x * 0.5f + 0.5f) * Width, (ndc.y * 0.5f + 0.5f) * Height);
+            low = glm::min(low, pixel);
+            high = glm::max(high, pixel);
+            nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+        }
+        if (high.x < 0.0f || high.y < 0.0f || low.x >= Width || low.y >= Height)
+            return true; // off screen, that is the frustum test's call
+        int x0 = std::max(0, (int)std::floor(low.x) / TileSize), x1 = std::min(TilesX - 1, (int)std::floor(high.x) / TileSize);
+        int y0 = std::max(0, (int)std::floor(low.y) / TileSize), y1 = std::min(TilesY - 1, (int)std::floor(high.y) / TileSize);
+        for (int ty = y0; ty <= y1; ty++)
+        {
+            const float *row = &tiles[ty * TilesX];
+            int tx = x0;
+#ifdef BOUNDS_SSE
+            __m128 boxDepth = _mm_set1_ps(nearest);
+            for (; tx + 3 <= x1; tx += 4)
+                if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + tx), boxDepth)))
+                    return true;
+#endif
+            for (; tx <= x1; tx++)
+                if (row[tx] >= nearest)
+                    return true;
+        }
+        return false;
+    }
+
+    unsigned int RasterizedTriangles() const { return triangles; }
+
+private:
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    std::vector<float> depth; // nearest occluder depth per pixel, [0, 1]
+    std::vector<float> tiles; // farthest depth per tile
+    std::vector<glm::vec4> screen;
+    unsigned int triangles = 0;
+
+    // GL's near plane is z = -w in clip space; everything behind the camera is on the wrong side of it too
+    static bool nearClipped(const glm::vec4 &clip)
+    {
+        return clip.z < -clip.w || clip.w <= 0.0f;
+    }
+
+    // edge function: positive on the inner side of a -> b for counter-clockwise triangles
+    static float edge(const glm::vec4 &a, const glm::vec4 &b, float x, float y)
+    {
+        return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+    }
+
+    void rasterize(glm::vec4 a, glm::vec4 b, glm::vec4 c)
+    {
+        float area = edge(a, b, c.x, c.y);
+        if (std::fabs(area) < 1e-6f)
+            return;
+        // occluders are drawn from both sides, so clockwise triangles are turned around
+        if (area < 0.0f)
+        {
+            std::swap(b, c);
+            area = -area;
+        }
+        int minX = std::max(0, (int)std::floor(std::min(a.x, std::min(b.x, c.x)))) & ~3;
+        int maxX = std::min(Width - 1, (int)std::ceil(std::max(a.x, std::max(b.x, c.x))));
+        int minY = std::max(0, (int)std::floor(std::min(a.y, std::min(b.y, c.y))));
+        int maxY = std::min(Height - 1, (int)std::ceil(std::max(a.y, std::max(b.y, c.y))));
+        if (minX > maxX || minY > maxY)
+            return;
+        triangles++;
+
+        // the barycentric weights and depth are affine in screen space: a start value plus a step per pixel
+        float inverseArea = 1.0f / area;
+        float stepX0 = b.y - c.y, stepX1 = c.y - a.y, stepX2 = a.y - b.y;
+        float depthStepX = (stepX1 * (b.z - a.z) + stepX2 * (c.z - a.z)) * inverseArea;
+        for (int y = minY; y <= maxY; y++)
+        {
+            float px = minX + 0.5f, py = y + 0.5f;
+            float w0 = edge(b, c, px, py), w1 = edge(c, a, px, py), w2 = edge(a, b, px, py);
+            float z = a.z + (w1 * (b.z - a.z) + w2 * (c.z - a.z)) * inverseArea;
+            float *row = &depth[y * Width];
+#ifdef BOUNDS_SSE
+            __m128 lane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f), zero = _mm_setzero_ps();
+            __m128 e0 = _mm_add_ps(_mm_set1_ps(w0), _mm_mul_ps(lane, _mm_set1_ps(stepX0)));
+            __m128 e1 = _mm_add_ps(_mm_set1_ps(w1), _mm_mul_ps(lane, _mm_set1_ps(stepX1)));
+            __m128 e2 = _mm_add_ps(_mm_set1_ps(w2), _mm_mul_ps(lane, _mm_set1_ps(stepX2)));
+            __m128 zs = _mm_add_ps(_mm_set1_ps(z), _mm_mul_ps(lane, _mm_set1_ps(depthStepX)));
+            __m128 step0 = _mm_set1_ps(4.0f * stepX0), step1 = _mm_set1_ps(4.0f * stepX1), step2 = _mm_set1_ps(4.0f * stepX2);
+            __m128 zStep = _mm_set1_ps(4.0f * depthStepX);
+            for (int x = minX; x <= maxX; x += 4)
+            {
+                __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+                if (_mm_movemask_ps(inside))
+                {
+                    __m128 stored = _mm_loadu_ps(row + x);
+                    __m128 nearer = _mm_min_ps(stored, zs);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, stored)));
+                }
+                e0 = _mm_add_ps(e0, step0);
+                e1 = _mm_add_ps(e1, step1);
+                e2 = _mm_add_ps(e2, step2);
+                zs = _mm_add_ps(zs, zStep);
+            }
+#else
+            for (int x = minX; x <= maxX; x++)
+            {
+                if (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f)
+                    row[x] = std::min(row[x], z);
+                w0 += stepX0;
+                w1 += stepX1;
+                w2 += stepX2;
+                z += depthStepX;
+            }
+#endif
+        }
+    }
+};
+
+#endif
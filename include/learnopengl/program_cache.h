@@ -0,0 +1,157 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/cache_file.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Linked programs are stored in resources/cache/programs as the driver's own binary, one file per program:
+//
+//   ProgramHeader | binary
+//
+// The file name is a hash of every stage's final source (includes resolved, variant #defines in place) and of
+// the GL vendor, renderer and version strings, so editing a shader or updating the driver just misses the
+// cache. Drivers may still reject a binary they wrote themselves; the caller then compiles from source and
+// the entry is replaced.
+namespace ProgramCache {
+
+    const uint32_t Magic = 0x42504752; // "RGPB"
+    const uint32_t Version = 1;
+
+    struct ProgramHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint32_t binaryFormat;
+        uint32_t binaryLength;
+    };
+
+    inline std::string Directory()
+    {
+        return "resources/cache/programs";
+    }
+
+    // some drivers (and every context without 4.1) offer no binary formats at all
+    inline bool Enabled()
+    {
+        static int formats = -1;
+        if (formats < 0)
+        {
+            GLint count = 0;
+            if (GLAD_GL_VERSION_4_1)
+                glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+            formats = count;
+        }
+        return formats > 0;
+    }
+
+    // 'stages' are the sources in a fixed stage order, empty for a stage the program doesn't have
+    inline uint64_t KeyFor(const std::vector<std::string> &stages)
+    {
+        uint64_t hash = HashBytes(&Version, sizeof(Version));
+        for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+        {
+            const char *driver = (const char*)glGetString(name);
+            if (driver)
+                hash = HashBytes(driver, std::strlen(driver), hash);
+        }
+        for (const std::string &source : stages)
+        {
+            uint64_t size = source.size();
+            hash = HashBytes(&size, sizeof(size), hash);
+            hash = HashWords(source.data(), source.size(), hash);
+        }
+        return hash;
+    }
+
+    inline std::string PathFor(uint64_t key)
+    {
+        char name[17];
+        snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+        return Directory() + '/' + name + ".bin";
+    }
+
+    // a new program linked from the cached binary, or 0 when there is none or the driver refuses it
+    inline GLuint Load(uint64_t key)
+    {
+        if (!Enabled())
+            return 0;
+        std::string path = PathFor(key);
+        MappedFile file;
+        if (!file.open(path) || file.size < sizeof(ProgramHeader))
+            return 0;
+        const ProgramHeader *header = (const ProgramHeader*)file.data;
+        if (header->magic != Magic || header->version != Version || header->key != key ||
+            sizeof(ProgramHeader) + (size_t)header->binaryLength > file.size)
+            return 0;
+
+        GLuint program = glCreateProgram();
+        glProgramBinary(program, header->binaryFormat, file.data + sizeof(ProgramHeader), (GLsizei)header->binaryLength);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked)
+        {
+            glDeleteProgram(program);
+            file.close();
+            std::remove(path.c_str());
+            return 0;
+        }
+        return program;
+    }
+
+    // call before linking a program that is going to be stored
+    inline void MarkRetrievable(GLuint program)
+    {
+        if (Enabled())
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // writes the binary of a successfully linked program; anything else is left out of the cache
+    inline bool Store(uint64_t key, GLuint program)
+    {
+        GLint linked = GL_FALSE, length = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!Enabled() || !linked)
+            return false;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return false;
+        std::vector<unsigned char> binary((size_t)length);
+        GLenum format = 0;
+        GLsizei written = 0;
+        glGetProgramBinary(program, length, &written, &format, binary.data());
+        if (written <= 0)
+            return false;
+
+        ProgramHeader header = {};
+        header.magic = Magic;
+        header.version = Version;
+        header.key = key;
+        header.binaryFormat = format;
+        header.binaryLength = (uint32_t)written;
+
+        CreateDirectories(Directory());
+        std::string path = PathFor(key), tempPath = path + ".tmp";
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)binary.data(), written);
+        out.close();
+        if (!out)
+        {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+        return std::rename(tempPath.c_str(), path.c_str()) == 0;
+    }
+}
+
+#endif
@@ -0,0 +1,568 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/bounds.h>
+#include <learnopengl/gpu_culler.h>
+#include <learnopengl/material.h>
+#include <learnopengl/model.h>
+#include <learnopengl/occlusion_culler.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/uniform_blocks.h>
+#include <learnopengl/uniform_ring.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+// fixed function state of a draw, besides program, vertex layout and material
+enum PipelineState : unsigned int {
+    PipelineOpaque   = 0,
+    PipelineCullBack = 1 << 0, // closed meshes: skip back faces
+    PipelineBlend    = 1 << 1, // alpha blended, drawn after everything opaque, back to front
+    PipelineAlphaTest = 1 << 2 // the shader discards by the diffuse alpha, so the depth pre-pass has to as well
+};
+
+// the programs of a depth pre-pass: one reading positions only, and one for PipelineAlphaTest items, which also
+// needs texture coordinates and the diffuse texture to discard the same fragments as the scene shader
+struct DepthPrepass {
+    Shader *depthShader;
+    Shader *alphaTestedDepthShader;
+};
+
+struct RenderStats {
+    unsigned int draws = 0;                  // draw calls, one multi-draw per batch
+    unsigned int prepassDraws = 0;           // of them in the depth pre-pass
+    unsigned int meshes = 0;                 // meshes drawn by them, every instance counted (before culling on the GPU)
+    unsigned int objects = 0;                // submitted instances inside the view frustum, all of them when culled on the GPU
+    unsigned int culledObjects = 0;          // submitted instances outside of it
+    unsigned int occludedObjects = 0;        // instances inside it, but hidden behind the occluders
+    unsigned int culledMeshes = 0;           // meshes not drawn, of culled or occluded instances or on their own
+    unsigned int meshlets = 0;               // meshlets tested, of meshes drawn at LOD 0 by a single instance
+    unsigned int culledMeshlets = 0;         // of them outside the view frustum
+    unsigned int backfacingMeshlets = 0;     // of them facing away from the camera entirely
+    unsigned int meshletTriangles = 0;       // triangles of the tested meshlets
+    unsigned int culledMeshletTriangles = 0; // of them dropped with their meshlet
+    unsigned int stateChanges = 0;           // binds and enables that reached GL
+    unsigned int skippedChanges = 0;         // the ones that matched what was already bound
+    unsigned int fragmentInvocations = 0;    // fragment shader runs of the scene pass, filled in by the caller from a query
+};
+
+// Shadow copy of the GL state the render queue touches. Every setter compares against what it last bound and
+// only calls GL on a change. Call Invalidate() after anything else changed that state behind its back.
+class RenderState {
+public:
+    RenderState() { Invalidate(); }
+
+    void Invalidate()
+    {
+        program = vertexArray = Unknown;
+        material = nullptr;
+        materialKnown = false;
+        objectBuffer = indirectBuffer = Unknown;
+        objectOffset = (size_t)-1;
+        pipeline = Unknown;
+    }
+
+    void UseProgram(const Shader &shader)
+    {
+        if (changed(program, shader.ID))
+            glUseProgram(shader.ID);
+    }
+
+    void BindVertexArray(unsigned int vao)
+    {
+        if (changed(vertexArray, vao))
+            glBindVertexArray(vao);
+    }
+
+    void BindMaterial(const Material *bound)
+    {
+        if (materialKnown && material == bound)
+        {
+            stats.skippedChanges++;
+            return;
+        }
+        stats.stateChanges++;
+        material = bound;
+        materialKnown = true;
+        bound->Bind();
+    }
+
+    // the frame's ObjectBlocks and the object indices the instances read them through, both in 'buffer'
+    void BindObjects(unsigned int buffer, size_t objectsOffset, size_t objectsSize, size_t indicesOffset, size_t indicesSize)
+    {
+        if (buffer == objectBuffer && objectsOffset == objectOffset)
+        {
+            stats.skippedChanges++;
+            return;
+        }
+        stats.stateChanges++;
+        objectBuffer = buffer;
+        objectOffset = objectsOffset;
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, ObjectBufferBinding, buffer, (GLintptr)objectsOffset, (GLsizeiptr)objectsSize);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, ObjectIndexBufferBinding, buffer, (GLintptr)indicesOffset, (GLsizeiptr)indicesSize);
+    }
+
+    void BindIndirectBuffer(unsigned int buffer)
+    {
+        if (changed(indirectBuffer, buffer))
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+    }
+
+    void SetPipeline(unsigned int state)
+    {
+        if (pipeline == Unknown || ((pipeline ^ state) & PipelineCullBack))
+            enable(GL_CULL_FACE, (state & PipelineCullBack) != 0);
+        else
+            stats.skippedChanges++;
+        if (pipeline == Unknown || ((pipeline ^ state) & PipelineBlend))
+            enable(GL_BLEND, (state & PipelineBlend) != 0);
+        else
+            stats.skippedChanges++;
+        pipeline = state;
+    }
+
+    const RenderStats &Stats() const { return stats; }
+    void ResetStats() { stats = RenderStats(); }
+
+    RenderStats stats;
+
+private:
+    static const unsigned int Unknown = 0xFFFFFFFFu;
+
+    unsigned int program, vertexArray, pipeline;
+    const Material *material;
+    bool materialKnown;
+    unsigned int objectBuffer, indirectBuffer;
+    size_t objectOffset;
+
+    bool changed(unsigned int &current, unsigned int value)
+    {
+        if (current == value)
+        {
+            stats.skippedChanges++;
+            return false;
+        }
+        stats.stateChanges++;
+        current = value;
+        return true;
+    }
+
+    void enable(GLenum capability, bool enabled)
+    {
+        stats.stateChanges++;
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+};
+
+// Collects the frame's draws, one item per mesh and level of detail (with all its instances at that level), and
+// issues them sorted by a 64-bit key:
+//
+//   opaque:  0 | depth bucket:3 | program:7 | pipeline:3 | vertex layout:4 | material:16 | depth:30
+//   blended: 1 | inverted depth:32 | program:7 | material:16 | unused:8
+//
+// Opaque items are grouped by state but stay roughly front to back for early-z: the coarse bucket (distance
+// doubling from one bucket to the next) comes first, the exact depth only orders items with identical state.
+// Blended items are strictly back to front. A RenderState drops every bind the sorted order makes redundant.
+//
+// Submissions are frustum and occlusion culled first per instance against the model's bounds, then per mesh
+// of the instances left. Each mesh keeps a list of its visible instances as indices into the frame's ObjectBlocks.
+// A mesh drawn at LOD 0 by a single instance goes further and is culled per meshlet: meshlets off screen or
+// entirely back facing are dropped, and each run of consecutive meshlets left becomes one command of its batch.
+//
+// The frame's indirect commands, ObjectBlocks and object indices go into the uniform ring once, and every run
+// of items with the same state is a single glMultiDrawElementsIndirect over its commands. Each command's
+// instances read consecutive object indices from its baseInstance on, so a thousand instances of a model cost
+// one command per mesh, not a thousand. The number of draw calls depends on the materials and states in view, not on how
+// many objects use them. Textures are still bound per batch (core GL has no bindless textures), which is why
+// the material is part of the batch.
+//
+// With a GpuCuller, submissions skip every CPU test: each mesh item reserves object indices for all of its
+// instances, its command goes up with an instanceCount of 0, and a compute pass fills in the visible ones right
+// before the batches are drawn. The CPU work then only depends on what is submitted.
+//
+// With a DepthPrepass, Execute() draws the opaque items twice over the same commands: depth only first, from the
+// pool's position-only stream, then shaded with depth writes off and GL_EQUAL, so overdraw costs depth tests
+// instead of lighting. Both vertex shaders declare gl_Position invariant for the depths to match exactly.
+class RenderQueue {
+public:
+    explicit RenderQueue(UniformRing &ring) : ring(ring) {}
+
+    // starts a new frame, depths are measured from 'cameraPosition' and culling uses 'viewProjection'. with an
+    // 'occlusion' culler, which must have its occluders drawn already, hidden instances and meshes are dropped too.
+    void Begin(const glm::vec3 &cameraPosition, const glm::mat4 &viewProjection, const OcclusionCuller *occlusion = nullptr)
+    {
+        items.clear();
+        objects.clear();
+        objectIndices.clear();
+        camera = cameraPosition;
+        frustum.Set(viewProjection);
+        this->occlusion = occlusion;
+        runs.clear();
+        culledObjects = occludedObjects = culledMeshes = 0;
+        meshlets = culledMeshlets = backfacingMeshlets = meshletTriangles = culledMeshletTriangles = 0;
+    }
+
+    // null culls on the CPU, at Begin() and Submit()
+    void UseGpuCulling(GpuCuller *culler) { gpuCuller = culler; }
+
+    // queues every mesh of 'model' at its current level of detail
+    void Submit(Model &model, Shader &shader, const glm::mat4 &transform, unsigned int pipeline = PipelineOpaque)
+    {
+        SubmitInstanced(model, shader, &transform, 1, nullptr, pipeline);
+    }
+
+    // queues 'count' instances of 'model', drawn together. 'tints' holds one ObjectBlock::tint per instance,
+    // or is null for untinted ones. each instance is drawn at the level Model::InstanceLod() has for it.
+    void SubmitInstanced(Model &model, Shader &shader, const glm::mat4 *transforms, size_t count, const glm::vec4 *tints = nullptr,
+                         unsigned int pipeline = PipelineOpaque)
+    {
+        visible.clear();
+        visibleLods.clear();
+        // opaque instances sort by the nearest one, blended ones by the farthest
+        float distance = (pipeline & PipelineBlend) ? 0.0f : std::numeric_limits<float>::max();
+        for (size_t i = 0; i < count; i++)
+        {
+            bool inside = gpuCuller || frustum.Intersects(model.ModelBounds(), transforms[i]);
+            if (!inside || (!gpuCuller && occlusion && !occlusion->Visible(model.ModelBounds(), transforms[i])))
+            {
+                (inside ? occludedObjects : culledObjects)++;
+                culledMeshes += (unsigned int)model.meshes.size();
+                continue;
+            }
+            visible.push_back((uint32_t)objects.size());
+            visibleLods.push_back(std::min(model.InstanceLod(i), 31u));
+            objects.push_back(MakeObjectBlock(transforms[i], tints ? tints[i] : glm::vec4(1.0f)));
+            float instanceDistance = glm::length(glm::vec3(transforms[i] * glm::vec4(model.BoundsCenter(), 1.0f)) - camera);
+            distance = (pipeline & PipelineBlend) ? std::max(distance, instanceDistance) : std::min(distance, instanceDistance);
+        }
+        if (visible.empty())
+            return;
+        uint64_t programIndex = indexOf(programs, shader.ID) & 0x7F;
+        // instances at different levels of detail draw different index ranges, every level gets items of its own
+        uint32_t levels = 0;
+        for (uint32_t lod : visibleLods)
+            levels |= 1u << lod;
+        for (uint32_t lod = 0; levels >> lod; lod++)
+        {
+            if (!(levels & (1u << lod)))
+                continue;
+            for (Mesh &mesh : model.meshes)
+                submitMesh(mesh, shader, pipeline, lod, model.meshes.size() == 1, programIndex, distance);
+        }
+    }
+
+    // sorts and draws everything queued, then leaves blending on, culling off and no VAO bound, like the rest
+    // of the frame expects. with a 'prepass', the opaque items' depth is laid down first and they are shaded
+    // with GL_EQUAL, so every covered pixel runs the scene's fragment shader about once.
+    void Execute(RenderState &state, const DepthPrepass *prepass = nullptr)
+    {
+        std::sort(items.begin(), items.end(), [](const Item &a, const Item &b) { return a.key < b.key; });
+        state.Invalidate();
+        state.stats.objects += (unsigned int)objects.size();
+        state.stats.culledObjects += culledObjects;
+        state.stats.occludedObjects += occludedObjects;
+        state.stats.culledMeshes += culledMeshes;
+        state.stats.meshlets += meshlets;
+        state.stats.culledMeshlets += culledMeshlets;
+        state.stats.backfacingMeshlets += backfacingMeshlets;
+        state.stats.meshletTriangles += meshletTriangles;
+        state.stats.culledMeshletTriangles += culledMeshletTriangles;
+        if (items.empty())
+            return;
+        // every command of the frame, batch after batch, every ObjectBlock and every object index go up in one
+        // write each. culled on the GPU, the commands start empty and the indices are only reserved.
+        commands.clear();
+        for (Item &item : items)
+        {
+            item.firstCommand = (uint32_t)commands.size();
+            if (item.runCount == 0)
+                commands.push_back(item.mesh->LodCommand(item.lod, gpuCuller ? 0 : item.instanceCount, item.firstInstance));
+            for (uint32_t run = item.firstRun; run < item.firstRun + item.runCount; run++)
+                commands.push_back(item.mesh->RangeCommand(runs[run].indexOffset, runs[run].indexCount, item.instanceCount, item.firstInstance));
+        }
+        size_t commandBytes = commands.size() * sizeof(DrawElementsIndirectCommand);
+        size_t objectBytes = objects.size() * sizeof(ObjectBlock), indexBytes = objectIndices.size() * sizeof(uint32_t);
+        // all at once, so a growing ring can't leave the first offsets stale; every instance has one cull record
+        ring.Reserve({ commandBytes, objectBytes, indexBytes, gpuCuller ? objectIndices.size() * sizeof(CullRecord) : 0 });
+        size_t commandOffset = ring.Write(commands.data(), commandBytes);
+        size_t objectOffset = ring.Write(objects.data(), objectBytes);
+        size_t indexOffset = gpuCuller ? ring.Allocate(indexBytes) : ring.Write(objectIndices.data(), indexBytes);
+        state.BindObjects(ring.Buffer(), objectOffset, objectBytes, indexOffset, indexBytes);
+        state.BindIndirectBuffer(ring.Buffer());
+        if (gpuCuller)
+            cullOnGpu(commandOffset);
+        if (prepass)
+            drawDepthPrepass(state, *prepass, commandOffset);
+
+        for (size_t begin = 0, end; begin < items.size(); begin = end)
+        {
+            const Item &first = items[begin];
+            for (end = begin + 1; end < items.size() && sameBatch(first, items[end]); end++)
+                ;
+            // blended items are not in the pre-pass' depth
+            if (prepass && (first.pipeline & PipelineBlend) && (begin == 0 || !(items[begin - 1].pipeline & PipelineBlend)))
+                endDepthPrepass();
+            state.SetPipeline(first.pipeline);
+            state.UseProgram(*first.shader);
+            state.BindVertexArray(first.mesh->VAO);
+            state.BindMaterial(first.mesh->material.get());
+            for (size_t i = begin; i < end; i++)
+            {
+                items[i].mesh->ConfigureSamplers(*first.shader);
+                state.stats.meshes += items[i].instanceCount;
+            }
+            multiDraw(state, begin, end, commandOffset);
+        }
+        if (prepass && !(items.back().pipeline & PipelineBlend))
+            endDepthPrepass();
+        state.SetPipeline(PipelineBlend);
+        state.BindVertexArray(0);
+    }
+
+    size_t Size() const { return items.size(); }
+
+private:
+    struct Item {
+        uint64_t key;
+        Mesh *mesh;
+        Shader *shader;
+        unsigned int pipeline;
+        uint32_t firstInstance; // the instances' entries in objectIndices
+        uint32_t instanceCount;
+        uint32_t firstRun;      // the visible meshlets' index runs in 'runs', none when drawn whole
+        uint32_t runCount;
+        uint32_t lod;           // of the mesh, the same for all instances of the item
+        uint32_t firstCommand;  // set by Execute(), one command per run or one for the whole mesh
+    };
+
+    // consecutive visible meshlets, merged into one index range of their mesh
+    struct IndexRun {
+        uint32_t indexOffset;
+        uint32_t indexCount;
+    };
+
+    UniformRing &ring;
+    glm::vec3 camera = glm::vec3(0.0f);
+    std::vector<Item> items;
+    Frustum frustum;
+    std::vector<ObjectBlock> objects;
+    std::vector<uint32_t> objectIndices, visible, visibleLods;
+    const OcclusionCuller *occlusion = nullptr;
+    GpuCuller *gpuCuller = nullptr;
+    std::vector<CullRecord> cullRecords;
+    unsigned int culledObjects = 0, occludedObjects = 0, culledMeshes = 0;
+    std::vector<IndexRun> runs;
+    unsigned int meshlets = 0, culledMeshlets = 0, backfacingMeshlets = 0, meshletTriangles = 0, culledMeshletTriangles = 0;
+
+    bool meshVisible(const Mesh &mesh, const glm::mat4 &transform) const
+    {
+        return frustum.Intersects(mesh.bounds, transform) && (!occlusion || occlusion->Visible(mesh.bounds, transform));
+    }
+
+    // queues 'mesh' for the instances in 'visible' drawn at level 'lod', less the ones that cull it. a single
+    // mesh has its model's bounds, there is nothing more to reject.
+    void submitMesh(Mesh &mesh, Shader &shader, unsigned int pipeline, uint32_t lod, bool onlyMesh, uint64_t programIndex, float distance)
+    {
+        size_t firstInstance = objectIndices.size();
+        for (size_t i = 0; i < visible.size(); i++)
+        {
+            if (visibleLods[i] != lod)
+                continue;
+            if (gpuCuller || onlyMesh || meshVisible(mesh, objects[visible[i]].model))
+                objectIndices.push_back(visible[i]);
+            else
+                culledMeshes++;
+        }
+        if (objectIndices.size() == firstInstance)
+            return;
+        Item item;
+        item.mesh = &mesh;
+        item.shader = &shader;
+        item.pipeline = pipeline;
+        item.lod = std::min<uint32_t>(lod, (uint32_t)mesh.lods.size() - 1);
+        item.firstInstance = (uint32_t)firstInstance;
+        item.instanceCount = (uint32_t)(objectIndices.size() - firstInstance);
+        item.firstRun = (uint32_t)runs.size();
+        item.runCount = 0;
+        if (!gpuCuller && item.instanceCount == 1 && item.lod == 0 && !mesh.meshlets.empty())
+        {
+            item.runCount = cullMeshlets(mesh, objects[objectIndices[firstInstance]].model, pipeline);
+            if (item.runCount == 0)
+            {
+                objectIndices.resize(firstInstance);
+                culledMeshes++;
+                return;
+            }
+        }
+        uint64_t material = mesh.material->Id() & 0xFFFF;
+        uint64_t depth = depthBits(distance);
+        if (pipeline & PipelineBlend)
+            item.key = (1ull << 63) | ((~depth & 0xFFFFFFFFull) << 31) | (programIndex << 24) | (material << 8);
+        else
+            item.key = (depthBucket(distance) << 60) | (programIndex << 53) | ((uint64_t)(pipeline & 0x7) << 50) |
+                       ((indexOf(layouts, layoutOf(mesh)) & 0xF) << 46) | (material << 30) | ((depth >> 3) & 0x3FFFFFFFull);
+        items.push_back(item);
+    }
+    std::vector<DrawElementsIndirectCommand> commands;
+
+    // the commands of items [begin, end) as one draw call
+    void multiDraw(RenderState &state, size_t begin, size_t end, size_t commandOffset)
+    {
+        size_t firstCommand = items[begin].firstCommand, endCommand = end < items.size() ? items[end].firstCommand : commands.size();
+        glMultiDrawElementsIndirect(GL_TRIANGLES, items[begin].mesh->indexType,
+                                    (const void*)(commandOffset + firstCommand * sizeof(DrawElementsIndirectCommand)),
+                                    (GLsizei)(endCommand - firstCommand), 0);
+        state.stats.draws++;
+    }
+
+    // depth only, same commands: plain items read the position-only stream and need no material, so their
+    // batches merge across programs and materials; alpha tested ones still bind their textures. leaves depth
+    // writes off and the depth test at GL_EQUAL for the shading pass.
+    void drawDepthPrepass(RenderState &state, const DepthPrepass &prepass, size_t commandOffset)
+    {
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        for (size_t begin = 0, end; begin < items.size() && !(items[begin].pipeline & PipelineBlend); begin = end)
+        {
+            const Item &first = items[begin];
+            for (end = begin + 1; end < items.size() && sameDepthBatch(first, items[end]); end++)
+                ;
+            bool alphaTested = (first.pipeline & PipelineAlphaTest) != 0;
+            Shader &shader = alphaTested ? *prepass.alphaTestedDepthShader : *prepass.depthShader;
+            state.SetPipeline(first.pipeline);
+            state.UseProgram(shader);
+            state.BindVertexArray(alphaTested ? first.mesh->VAO : first.mesh->positionVAO);
+            if (alphaTested)
+            {
+                state.BindMaterial(first.mesh->material.get());
+                for (size_t i = begin; i < end; i++)
+                    items[i].mesh->ConfigureSamplers(shader);
+            }
+            multiDraw(state, begin, end, commandOffset);
+            state.stats.prepassDraws++;
+        }
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(GL_FALSE);
+        glDepthFunc(GL_EQUAL);
+    }
+
+    void endDepthPrepass()
+    {
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+    }
+
+    // appends the runs of visible meshlets of 'mesh' and returns how many there are. the cone test only runs with
+    // back faces culled anyway, and under a uniform scale, which keeps the normals' directions in model space.
+    uint32_t cullMeshlets(const Mesh &mesh, const glm::mat4 &transform, unsigned int pipeline)
+    {
+        glm::vec3 scales(glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])));
+        float scale = std::max(scales.x, std::max(scales.y, scales.z));
+        bool coneTest = (pipeline & PipelineCullBack) && std::min(scales.x, std::min(scales.y, scales.z)) > scale * 0.99f;
+        glm::vec3 eye = glm::vec3(glm::inverse(transform) * glm::vec4(camera, 1.0f));
+        size_t firstRun = runs.size();
+        for (const Meshlet &meshlet : mesh.meshlets)
+        {
+            meshlets++;
+            meshletTriangles += meshlet.indexCount / 3;
+            if (!frustum.Intersects(glm::vec3(transform * glm::vec4(meshlet.center, 1.0f)), meshlet.radius * scale))
+            {
+                culledMeshlets++;
+                culledMeshletTriangles += meshlet.indexCount / 3;
+                continue;
+            }
+            // every normal in the cone points away when the view direction to the sphere, widened by the
+            // sphere's size, stays within 90 degrees minus the cone's half angle of the axis (conservative)
+            glm::vec3 direction = meshlet.center - eye;
+            if (coneTest && meshlet.coneCutoff < 1.0f &&
+                glm::dot(direction, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(direction) + meshlet.radius)
+            {
+                backfacingMeshlets++;
+                culledMeshletTriangles += meshlet.indexCount / 3;
+                continue;
+            }
+            if (runs.size() > firstRun && runs.back().indexOffset + runs.back().indexCount == meshlet.indexOffset)
+                runs.back().indexCount += meshlet.indexCount;
+            else
+                runs.push_back({ meshlet.indexOffset, meshlet.indexCount });
+        }
+        return (uint32_t)(runs.size() - firstRun);
+    }
+
+    // one record per reserved object index, for the command of its item
+    void cullOnGpu(size_t commandOffset)
+    {
+        cullRecords.clear();
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            const Bounds &bounds = items[i].mesh->bounds;
+            for (uint32_t k = 0; k < items[i].instanceCount; k++)
+            {
+                CullRecord record = {};
+                record.object = objectIndices[items[i].firstInstance + k];
+                record.command = items[i].firstCommand;
+                record.center = glm::vec4(bounds.Center(), 0.0f);
+                record.extents = glm::vec4(bounds.Extents(), 0.0f);
+                cullRecords.push_back(record);
+            }
+        }
+        size_t recordOffset = ring.Write(cullRecords.data(), cullRecords.size() * sizeof(CullRecord));
+        gpuCuller->Cull(ring.Buffer(), recordOffset, cullRecords.size(), commandOffset, commands.size());
+    }
+    // small stable indices for GL names, in order of first appearance
+    std::vector<unsigned int> programs, layouts;
+
+    // one multi-draw takes one VAO and one index type
+    static unsigned int layoutOf(const Mesh &mesh)
+    {
+        return mesh.VAO * 2 + (mesh.indexType == GL_UNSIGNED_SHORT ? 1 : 0);
+    }
+
+    // the position-only VAO of a layout is as shared as the full one
+    static bool sameDepthBatch(const Item &a, const Item &b)
+    {
+        return a.pipeline == b.pipeline && layoutOf(*a.mesh) == layoutOf(*b.mesh) &&
+               (!(a.pipeline & PipelineAlphaTest) || (a.shader->ID == b.shader->ID && a.mesh->material == b.mesh->material));
+    }
+
+    static bool sameBatch(const Item &a, const Item &b)
+    {
+        return a.pipeline == b.pipeline && a.shader->ID == b.shader->ID && layoutOf(*a.mesh) == layoutOf(*b.mesh) &&
+               a.mesh->material == b.mesh->material;
+    }
+
+    static uint64_t indexOf(std::vector<unsigned int> &table, unsigned int name)
+    {
+        for (size_t i = 0; i < table.size(); i++)
+            if (table[i] == name)
+                return i;
+        table.push_back(name);
+        return table.size() - 1;
+    }
+
+    // non-negative floats sort like their bit patterns
+    static uint64_t depthBits(float distance)
+    {
+        float clamped = std::max(distance, 0.0f);
+        uint32_t bits;
+        std::memcpy(&bits, &clamped, sizeof(bits));
+        return bits;
+    }
+
+    // 0 below one unit, then one bucket per doubling of the distance
+    static uint64_t depthBucket(float distance)
+    {
+        return (uint64_t)std::min(7.0f, std::floor(std::log2(std::max(distance, 0.0f) + 1.0f)));
+    }
+};
+
+#endif
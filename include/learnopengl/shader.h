@@ -8,7 +8,19 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 #include <common.h>
+#include <learnopengl/program_cache.h>
+#include <learnopengl/shader_source.h>
+
+// a uniform's location, looked up once and then set through Shader::set without any name lookups.
+// T is the GLSL type as glm / C++ type; -1 (inactive or unknown uniform) makes every set a no-op, like GL does.
+template<typename T>
+struct UniformHandle {
+    GLint location = -1;
+};
+
 class Shader
 {
 public:
@@ -51,8 +63,6 @@ public:
             // if geometry shader path is present, also load a geometry shader
             if(geometryPath != nullptr)
             {
-                std::string geometryPathString(geometryPath);
-                geometryPath = geometryPathString.c_str();
                 gShaderFile.open(geometryPath);
                 std::stringstream gShaderStream;
                 gShaderStream << gShaderFile.rdbuf();
@@ -64,6 +74,19 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
+        // shaders can #include shared GLSL, see ShaderSource
+        vertexCode = ShaderSource::ResolveIncludes(vertexCode, vertexPath);
+        fragmentCode = ShaderSource::ResolveIncludes(fragmentCode, fragmentPath);
+        if(geometryPath != nullptr)
+            geometryCode = ShaderSource::ResolveIncludes(geometryCode, geometryPath);
+        // a program linked on an earlier run comes straight from the binary cache
+        uint64_t cacheKey = ProgramCache::KeyFor({ vertexCode, fragmentCode, geometryCode });
+        ID = ProgramCache::Load(cacheKey);
+        if (ID)
+        {
+            reflectUniforms();
+            return;
+        }
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
         // 2. compile shaders
@@ -90,18 +113,21 @@ public:
         }
         // shader Program
         ID = glCreateProgram();
+        ProgramCache::MarkRetrievable(ID);
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
         if(geometryPath != nullptr)
             glAttachShader(ID, geometry);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        ProgramCache::Store(cacheKey, ID);
         // delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
         glDeleteShader(fragment);
         if(geometryPath != nullptr)
             glDeleteShader(geometry);
 
+        reflectUniforms();
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -109,66 +135,130 @@ public:
     { 
         glUseProgram(ID); 
     }
+    // location of an active uniform from the table built at link time, -1 if there is no such uniform
+    // ------------------------------------------------------------------------
+    GLint location(const std::string &name) const
+    {
+        auto it = uniformLocations.find(name);
+        return it == uniformLocations.end() ? -1 : it->second;
+    }
+    template<typename T>
+    UniformHandle<T> handle(const std::string &name) const
+    {
+        UniformHandle<T> uniform;
+        uniform.location = location(name);
+        return uniform;
+    }
+    // setters through handles, for code running every frame
+    // ------------------------------------------------------------------------
+    void set(UniformHandle<bool> uniform, bool value) const { glUniform1i(uniform.location, (int)value); }
+    void set(UniformHandle<int> uniform, int value) const { glUniform1i(uniform.location, value); }
+    void set(UniformHandle<float> uniform, float value) const { glUniform1f(uniform.location, value); }
+    void set(UniformHandle<glm::vec2> uniform, const glm::vec2 &value) const { glUniform2fv(uniform.location, 1, &value[0]); }
+    void set(UniformHandle<glm::vec3> uniform, const glm::vec3 &value) const { glUniform3fv(uniform.location, 1, &value[0]); }
+    void set(UniformHandle<glm::vec4> uniform, const glm::vec4 &value) const { glUniform4fv(uniform.location, 1, &value[0]); }
+    void set(UniformHandle<glm::mat2> uniform, const glm::mat2 &mat) const { glUniformMatrix2fv(uniform.location, 1, GL_FALSE, &mat[0][0]); }
+    void set(UniformHandle<glm::mat3> uniform, const glm::mat3 &mat) const { glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &mat[0][0]); }
+    void set(UniformHandle<glm::mat4> uniform, const glm::mat4 &mat) const { glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]); }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(location(name), (int)value); 
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(location(name), value); 
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(location(name), value); 
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(location(name), 1, &value[0]); 
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(location(name), x, y); 
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(location(name), 1, &value[0]); 
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(location(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(location(name), 1, &value[0]); 
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(location(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
+    }
+
+protected:
+    // for shader kinds that build their program themselves, see ComputeShader
+    Shader() : ID(0) {}
+
+    // name -> location of every active uniform outside of uniform blocks
+    std::unordered_map<std::string, GLint> uniformLocations;
+
+    // fills uniformLocations from the linked program. arrays are reported once as "name[0]", so the bare
+    // name and every other element are added too.
+    // ------------------------------------------------------------------------
+    void reflectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramInterfaceiv(ID, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+        glGetProgramInterfaceiv(ID, GL_UNIFORM, GL_MAX_NAME_LENGTH, &maxLength);
+        std::vector<GLchar> name(maxLength + 1);
+        const GLenum properties[] = { GL_LOCATION, GL_ARRAY_SIZE };
+        for (GLint i = 0; i < count; i++)
+        {
+            GLint values[2];
+            glGetProgramResourceiv(ID, GL_UNIFORM, i, 2, properties, 2, NULL, values);
+            if (values[0] < 0) // uniform block member
+                continue;
+            GLsizei length = 0;
+            glGetProgramResourceName(ID, GL_UNIFORM, i, (GLsizei)name.size(), &length, name.data());
+            std::string uniform(name.data(), length);
+            uniformLocations[uniform] = values[0];
+            if (uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = uniform.substr(0, uniform.size() - 3);
+                uniformLocations[base] = values[0];
+                for (GLint element = 1; element < values[1]; element++)
+                {
+                    std::string elementName = base + '[' + std::to_string(element) + ']';
+                    uniformLocations[elementName] = glGetUniformLocation(ID, elementName.c_str());
+                }
+            }
+        }
     }
 
-private:
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
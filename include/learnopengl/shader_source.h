@@ -0,0 +1,119 @@
+#ifndef SHADER_SOURCE_H
+#define SHADER_SOURCE_H
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// The small preprocessing layer in front of glShaderSource:
+//   #include "file"  is replaced by that file, relative to the including one; every file is included once
+//   Define()         puts #defines right after the #version line, to compile variants of one source
+// #line directives keep compiler errors pointing at the right line. every included file gets its own source
+// string number, noted in a comment above it, so "3(12)" in a log can be traced back to its file.
+class ShaderSource {
+public:
+    // reads 'path' and resolves its includes
+    static std::string Load(const std::string &path)
+    {
+        std::string source;
+        if (!readFile(path, source))
+            return source;
+        return ResolveIncludes(source, path);
+    }
+
+    // resolves the includes of 'source', which was read from 'path'
+    static std::string ResolveIncludes(const std::string &source, const std::string &path)
+    {
+        std::set<std::string> included = { path };
+        int fileCount = 1;
+        return resolve(source, path, 0, included, fileCount);
+    }
+
+    static std::string Define(const std::string &source, const std::vector<std::string> &defines)
+    {
+        if (defines.empty())
+            return source;
+        size_t version = source.find("#version");
+        size_t insertAt = version == std::string::npos ? 0 : source.find('\n', version);
+        insertAt = insertAt == std::string::npos ? source.size() : insertAt + 1;
+        int line = 1 + (int)std::count(source.begin(), source.begin() + insertAt, '\n');
+        std::string block;
+        for (const std::string &define : defines)
+            block += "#define " + define + "\n";
+        block += "#line " + std::to_string(line) + "\n";
+        return source.substr(0, insertAt) + block + source.substr(insertAt);
+    }
+
+private:
+    static bool readFile(const std::string &path, std::string &source)
+    {
+        std::ifstream file;
+        file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            file.open(path);
+            std::stringstream stream;
+            stream << file.rdbuf();
+            file.close();
+            source = stream.str();
+            return true;
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+            return false;
+        }
+    }
+
+    static std::string directoryOf(const std::string &path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    }
+
+    static std::string resolve(const std::string &source, const std::string &path, int fileNumber,
+                               std::set<std::string> &included, int &fileCount)
+    {
+        std::string result;
+        std::istringstream lines(source);
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(lines, line))
+        {
+            lineNumber++;
+            size_t start = line.find_first_not_of(" \t");
+            if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+            {
+                result += line + "\n";
+                continue;
+            }
+            // a skipped include still takes up its line, so the numbering below it stays right
+            size_t open = line.find('"', start), close = line.find('"', open + 1);
+            if (open == std::string::npos || close == std::string::npos)
+            {
+                std::cout << "ERROR::SHADER::MALFORMED_INCLUDE in " << path << ": " << line << std::endl;
+                result += "\n";
+                continue;
+            }
+            std::string includePath = directoryOf(path) + line.substr(open + 1, close - open - 1);
+            std::string includeSource;
+            if (!included.insert(includePath).second || !readFile(includePath, includeSource))
+            {
+                result += "\n";
+                continue;
+            }
+            int includeNumber = fileCount++;
+            result += "// source string " + std::to_string(includeNumber) + ": " + includePath + "\n";
+            result += "#line 1 " + std::to_string(includeNumber) + "\n";
+            result += resolve(includeSource, includePath, includeNumber, included, fileCount);
+            result += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileNumber) + "\n";
+        }
+        return result;
+    }
+};
+
+#endif
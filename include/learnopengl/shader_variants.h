@@ -0,0 +1,220 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/program_cache.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/shader_source.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// compile time switches of the scene shaders, each one a #define in the GLSL
+enum ShaderFeature : unsigned int {
+    ShaderBlinn          = 1 << 0, // BLINN: Blinn-Phong instead of Phong specular
+    ShaderSpotLight      = 1 << 1, // SPOTLIGHT: lights can be spot lights, the cone falloff is compiled in
+    ShaderBloomOutput    = 1 << 2, // BLOOM_OUTPUT: also write the bright parts to the second colour target
+    ShaderAlphaTest      = 1 << 3, // ALPHA_TEST: discard fragments of cut-out textures
+    ShaderClusterHeatmap = 1 << 4, // CLUSTER_HEATMAP: tint by the number of lights in the cluster
+    ShaderFeatureCount   = 5
+};
+
+// features a stand-in variant has to match: ALPHA_TEST decides which fragments exist at all, BLOOM_OUTPUT what
+// the second colour target gets while two draw buffers are active
+const unsigned int ShaderExactFeatures = ShaderAlphaTest | ShaderBloomOutput;
+
+inline const char *ShaderFeatureDefine(unsigned int bit)
+{
+    static const char *defines[ShaderFeatureCount] = { "BLINN", "SPOTLIGHT", "BLOOM_OUTPUT", "ALPHA_TEST", "CLUSTER_HEATMAP" };
+    return defines[bit];
+}
+
+// one permutation, linked in two steps so the driver can compile it on its own threads in between
+class ShaderVariant : public Shader
+{
+public:
+    ShaderVariant(const std::string &vertexCode, const std::string &fragmentCode)
+            : cacheKey(ProgramCache::KeyFor({ vertexCode, fragmentCode, std::string() }))
+    {
+        // cached variants are linked right away, there is nothing to wait for
+        ID = ProgramCache::Load(cacheKey);
+        if (ID)
+        {
+            reflectUniforms();
+            linked = true;
+            return;
+        }
+        const char *vShaderCode = vertexCode.c_str();
+        const char *fShaderCode = fragmentCode.c_str();
+        vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vShaderCode, NULL);
+        glCompileShader(vertex);
+        fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragment, 1, &fShaderCode, NULL);
+        glCompileShader(fragment);
+        ID = glCreateProgram();
+        ProgramCache::MarkRetrievable(ID);
+        glAttachShader(ID, vertex);
+        glAttachShader(ID, fragment);
+        glLinkProgram(ID);
+    }
+
+    // the program itself belongs to ShaderVariants; shaders of a link that never finished are still around
+    ~ShaderVariant()
+    {
+        if (!linked)
+        {
+            glDeleteShader(vertex);
+            glDeleteShader(fragment);
+        }
+    }
+
+    ShaderVariant(const ShaderVariant&) = delete;
+    ShaderVariant &operator=(const ShaderVariant&) = delete;
+
+    // true once linked; never blocks when the driver compiles in parallel
+    bool Ready()
+    {
+        if (linked)
+            return true;
+        if (GLAD_GL_KHR_parallel_shader_compile)
+        {
+            GLint completed = GL_FALSE;
+            glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &completed);
+            if (!completed)
+                return false;
+        }
+        Finish();
+        return true;
+    }
+
+    // waits for the link, reports errors and builds the uniform table
+    void Finish()
+    {
+        if (linked)
+            return;
+        checkCompileErrors(vertex, "VERTEX");
+        checkCompileErrors(fragment, "FRAGMENT");
+        checkCompileErrors(ID, "PROGRAM");
+        ProgramCache::Store(cacheKey, ID);
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        reflectUniforms();
+        linked = true;
+    }
+
+private:
+    uint64_t cacheKey;
+    unsigned int vertex = 0, fragment = 0;
+    bool linked = false;
+};
+
+// All permutations of one vertex/fragment pair over the ShaderFeatures it supports. A variant is compiled the
+// first time it is asked for and kept; features the shader doesn't use are masked off, so they never make a
+// second copy of the same program. With GL_KHR_parallel_shader_compile, PrecompileNeighbours() starts variants
+// on the driver's threads ahead of time and Get() hands out the closest finished one until the asked one is done,
+// so switching a feature never waits on the compiler.
+class ShaderVariants {
+public:
+    ShaderVariants(const char *vertexPath, const char *fragmentPath, unsigned int supportedFeatures)
+            : supported(supportedFeatures)
+    {
+        vertexCode = ShaderSource::Load(vertexPath);
+        fragmentCode = ShaderSource::Load(fragmentPath);
+        ParallelCompile();
+    }
+
+    ShaderVariants(const ShaderVariants&) = delete;
+    ShaderVariants &operator=(const ShaderVariants&) = delete;
+
+    ~ShaderVariants()
+    {
+        for (auto &variant : variants)
+            glDeleteProgram(variant.second->ID);
+    }
+
+    // starts compiling 'features' and every variant one toggle away from it in the background. without
+    // parallel compilation variants are only compiled when first used.
+    void PrecompileNeighbours(unsigned int features)
+    {
+        if (!ParallelCompile())
+            return;
+        variant(features & supported);
+        for (unsigned int bit = 0; bit < ShaderFeatureCount; bit++)
+            if (supported & (1u << bit))
+                variant((features ^ (1u << bit)) & supported);
+    }
+
+    Shader &Get(unsigned int features)
+    {
+        features &= supported;
+        ShaderVariant &wanted = variant(features);
+        if (wanted.Ready())
+            return wanted;
+        // still compiling: the finished variant differing in the fewest features stands in, as long as it agrees
+        // on the ShaderExactFeatures. without one the caller waits for the link.
+        ShaderVariant *closest = nullptr;
+        unsigned int closestDistance = ShaderFeatureCount + 1;
+        for (auto &other : variants)
+        {
+            unsigned int distance = bitCount(other.first ^ features);
+            if ((other.first ^ features) & ShaderExactFeatures)
+                continue;
+            if (distance < closestDistance && other.second->Ready())
+            {
+                closest = other.second.get();
+                closestDistance = distance;
+            }
+        }
+        if (closest)
+            return *closest;
+        wanted.Finish();
+        return wanted;
+    }
+
+    // asks the driver for as many compiler threads as it likes, once; false without the extension
+    static bool ParallelCompile()
+    {
+        static bool enabled = false, checked = false;
+        if (!checked)
+        {
+            checked = true;
+            enabled = GLAD_GL_KHR_parallel_shader_compile != 0;
+            if (enabled)
+                glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        }
+        return enabled;
+    }
+
+private:
+    unsigned int supported;
+    std::string vertexCode, fragmentCode;
+    std::unordered_map<unsigned int, std::unique_ptr<ShaderVariant>> variants;
+
+    ShaderVariant &variant(unsigned int features)
+    {
+        std::unique_ptr<ShaderVariant> &slot = variants[features];
+        if (!slot)
+        {
+            std::vector<std::string> defines;
+            for (unsigned int bit = 0; bit < ShaderFeatureCount; bit++)
+                if (features & (1u << bit))
+                    defines.push_back(ShaderFeatureDefine(bit));
+            slot.reset(new ShaderVariant(ShaderSource::Define(vertexCode, defines), ShaderSource::Define(fragmentCode, defines)));
+        }
+        return *slot;
+    }
+
+    static unsigned int bitCount(unsigned int bits)
+    {
+        unsigned int count = 0;
+        for (; bits; bits &= bits - 1)
+            count++;
+        return count;
+    }
+};
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <stb_image.h>
+
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/texture_compressor.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// block compressed texture with its whole mip chain, either read from the cache or freshly transcoded
+struct CompressedTexture {
+    struct Level {
+        uint32_t width, height;
+        uint64_t offset; // relative to 'data'
+        uint64_t size;
+    };
+
+    uint32_t format = 0; // GL internal format, see TextureCompressor::Format
+    std::vector<Level> levels;
+    const unsigned char *data = nullptr;
+    size_t dataSize = 0;
+
+    // whichever of these owns 'data'
+    std::shared_ptr<MappedFile> file;
+    std::vector<unsigned char> storage;
+};
+
+// Transcoded textures are stored in resources/cache/textures as one file per source image:
+//
+//   TextureHeader | TextureLevel[levelCount] | compressed levels, largest first
+//
+// Like the mesh cache, the name comes from the source path and the header records a hash of the source
+// contents, so changing the image triggers a new transcode on the next start.
+namespace TextureCache {
+
+    const uint32_t Magic = 0x58544752; // "RGTX"
+    const uint32_t Version = 1;
+
+    struct TextureHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sourceHash;
+        uint32_t format;
+        uint32_t levelCount;
+    };
+
+    typedef CompressedTexture::Level TextureLevel;
+
+    inline std::string Directory()
+    {
+        return "resources/cache/textures";
+    }
+
+    // normal maps get their own file since they are compressed differently
+    inline std::string PathFor(const std::string &sourcePath, bool normalMap)
+    {
+        char name[17];
+        snprintf(name, sizeof(name), "%016llx", (unsigned long long)HashBytes(sourcePath.data(), sourcePath.size()));
+        return Directory() + '/' + name + (normalMap ? ".normal.tex" : ".tex");
+    }
+
+    inline uint64_t HashSource(const MappedFile &source)
+    {
+        return HashWords(source.data, source.size, HashBytes(&Version, sizeof(Version)));
+    }
+
+    // maps the cached file and checks it against the source hash. BC7 files are rejected when the context
+    // can't sample BPTC, so they get transcoded to BC3 instead, and BC1/BC3 files when it has no S3TC.
+    inline bool Load(const std::string &cachePath, uint64_t sourceHash, bool allowBC7, bool allowS3TC, CompressedTexture &texture)
+    {
+        std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+        if (!file->open(cachePath) || file->size < sizeof(TextureHeader))
+            return false;
+
+        const TextureHeader *header = (const TextureHeader*)file->data;
+        if (header->magic != Magic || header->version != Version || header->sourceHash != sourceHash ||
+            (header->format == TextureCompressor::BC7 && !allowBC7) ||
+            (TextureCompressor::IsS3TC(header->format) && !allowS3TC))
+            return false;
+        size_t tableEnd = sizeof(TextureHeader) + header->levelCount * sizeof(TextureLevel);
+        if (header->levelCount == 0 || tableEnd > file->size)
+            return false;
+
+        const TextureLevel *levels = (const TextureLevel*)(file->data + sizeof(TextureHeader));
+        for (uint32_t i = 0; i < header->levelCount; i++)
+            if (tableEnd + levels[i].offset + levels[i].size > file->size)
+                return false;
+
+        texture.format = header->format;
+        texture.levels.assign(levels, levels + header->levelCount);
+        texture.data = file->data + tableEnd;
+        texture.dataSize = file->size - tableEnd;
+        texture.file = file;
+        return true;
+    }
+
+    inline bool Store(const std::string &cachePath, uint64_t sourceHash, const CompressedTexture &texture)
+    {
+        TextureHeader header = {};
+        header.magic = Magic;
+        header.version = Version;
+        header.sourceHash = sourceHash;
+        header.format = texture.format;
+        header.levelCount = (uint32_t)texture.levels.size();
+
+        CreateDirectories(Directory());
+        std::string tempPath = cachePath + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)texture.levels.data(), (std::streamsize)(texture.levels.size() * sizeof(TextureLevel)));
+        out.write((const char*)texture.data, (std::streamsize)texture.dataSize);
+        out.close();
+        if (!out)
+        {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+        return std::rename(tempPath.c_str(), cachePath.c_str()) == 0;
+    }
+
+    // decodes an image file held in memory, builds its mip chain and block compresses every level.
+    // fails when the image needs an S3TC format the context can't sample, the caller uploads it uncompressed.
+    inline bool Transcode(const MappedFile &source, bool normalMap, bool allowBC7, bool allowS3TC, CompressedTexture &texture)
+    {
+        int width, height, components;
+        unsigned char *pixels = stbi_load_from_memory(source.data, (int)source.size, &width, &height, &components, 4);
+        if (!pixels)
+            return false;
+        TextureCompressor::Image base;
+        base.width = width;
+        base.height = height;
+        base.rgba.assign(pixels, pixels + (size_t)width * height * 4);
+        stbi_image_free(pixels);
+
+        TextureCompressor::Format format = TextureCompressor::ChooseFormat(base, components, normalMap, allowBC7);
+        if (TextureCompressor::IsS3TC(format) && !allowS3TC)
+            return false;
+        std::vector<TextureCompressor::Image> chain = TextureCompressor::BuildMipChain(std::move(base));
+
+        texture.format = format;
+        texture.levels.clear();
+        uint64_t offset = 0;
+        for (const TextureCompressor::Image &level : chain)
+        {
+            uint64_t size = TextureCompressor::CompressedSize(format, level.width, level.height);
+            texture.levels.push_back({ (uint32_t)level.width, (uint32_t)level.height, offset, size });
+            offset += size;
+        }
+        texture.storage.resize((size_t)offset);
+        for (size_t i = 0; i < chain.size(); i++)
+            TextureCompressor::Compress(chain[i], format, texture.storage.data() + texture.levels[i].offset);
+        texture.data = texture.storage.data();
+        texture.dataSize = texture.storage.size();
+        return true;
+    }
+}
+
+#endif
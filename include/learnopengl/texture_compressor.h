@@ -0,0 +1,455 @@
+#ifndef TEXTURE_COMPRESSOR_H
+#define TEXTURE_COMPRESSOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// CPU encoder for the block compressed formats we upload: BC1 (opaque colour), BC3 and BC7 (colour + alpha),
+// BC4 (single channel) and BC5 (two channel normal maps). Every format packs 4x4 texels into an 8 or 16 byte
+// block, which the GPU decodes on the fly while sampling, so textures take 4-8x less memory and bandwidth.
+//
+// The encoders fit endpoints along the principal axis of each block and refine them once with least squares;
+// that is nowhere near a production encoder's quality, but it is fast enough to run on the first start.
+// BC7 only uses mode 6 (one subset, RGBA endpoints, 4-bit indices), which already beats BC3 on alpha textures.
+namespace TextureCompressor {
+
+    // the values are the matching GL internal formats, so they can be handed to glCompressedTexImage2D directly
+    enum Format : uint32_t {
+        BC1 = 0x83F0, // GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+        BC3 = 0x83F3, // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+        BC4 = 0x8DBB, // GL_COMPRESSED_RED_RGTC1
+        BC5 = 0x8DBD, // GL_COMPRESSED_RG_RGTC2
+        BC7 = 0x8E8C  // GL_COMPRESSED_RGBA_BPTC_UNORM
+    };
+
+    // BC1 and BC3 come from GL_EXT_texture_compression_s3tc, which never made it into core
+    inline bool IsS3TC(uint32_t format)
+    {
+        return format == BC1 || format == BC3;
+    }
+
+    inline unsigned int BlockBytes(uint32_t format)
+    {
+        return format == BC1 || format == BC4 ? 8 : 16;
+    }
+
+    inline size_t CompressedSize(uint32_t format, int width, int height)
+    {
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(format);
+    }
+
+    // 8-bit RGBA image, one level of a mip chain
+    struct Image {
+        int width = 0, height = 0;
+        std::vector<unsigned char> rgba;
+    };
+
+    // box filters an image down to half its size; odd edges clamp, so a 5x5 level becomes 2x2
+    inline Image Downsample(const Image &source)
+    {
+        Image result;
+        result.width = std::max(1, source.width / 2);
+        result.height = std::max(1, source.height / 2);
+        result.rgba.resize((size_t)result.width * result.height * 4);
+        for (int y = 0; y < result.height; y++)
+        {
+            int y0 = std::min(y * 2, source.height - 1), y1 = std::min(y * 2 + 1, source.height - 1);
+            for (int x = 0; x < result.width; x++)
+            {
+                int x0 = std::min(x * 2, source.width - 1), x1 = std::min(x * 2 + 1, source.width - 1);
+                const unsigned char *a = &source.rgba[((size_t)y0 * source.width + x0) * 4];
+                const unsigned char *b = &source.rgba[((size_t)y0 * source.width + x1) * 4];
+                const unsigned char *c = &source.rgba[((size_t)y1 * source.width + x0) * 4];
+                const unsigned char *d = &source.rgba[((size_t)y1 * source.width + x1) * 4];
+                unsigned char *out = &result.rgba[((size_t)y * result.width + x) * 4];
+                for (int i = 0; i < 4; i++)
+                    out[i] = (unsigned char)((a[i] + b[i] + c[i] + d[i] + 2) / 4);
+            }
+        }
+        return result;
+    }
+
+    // full mip chain down to 1x1, level 0 first
+    inline std::vector<Image> BuildMipChain(Image base)
+    {
+        std::vector<Image> levels;
+        levels.push_back(std::move(base));
+        while (levels.back().width > 1 || levels.back().height > 1)
+            levels.push_back(Downsample(levels.back()));
+        return levels;
+    }
+
+    inline bool HasAlpha(const Image &image)
+    {
+        for (size_t i = 3; i < image.rgba.size(); i += 4)
+            if (image.rgba[i] != 255)
+                return true;
+        return false;
+    }
+
+    // picks the format for a texture. 'components' is what the source file stores.
+    inline Format ChooseFormat(const Image &image, int components, bool normalMap, bool allowBC7)
+    {
+        if (normalMap)
+            return BC5;
+        if (components == 1)
+            return BC4;
+        if (HasAlpha(image))
+            return allowBC7 ? BC7 : BC3;
+        return BC1;
+    }
+
+    // copies the 4x4 block at (blockX, blockY), clamping at the right and bottom edges
+    inline void FetchBlock(const Image &image, int blockX, int blockY, unsigned char block[64])
+    {
+        for (int y = 0; y < 4; y++)
+        {
+            int sy = std::min(blockY * 4 + y, image.height - 1);
+            for (int x = 0; x < 4; x++)
+            {
+                int sx = std::min(blockX * 4 + x, image.width - 1);
+                std::memcpy(block + (y * 4 + x) * 4, &image.rgba[((size_t)sy * image.width + sx) * 4], 4);
+            }
+        }
+    }
+
+    // mean and dominant direction of the first 'channels' channels of a block, by power iteration
+    inline void PrincipalAxis(const unsigned char block[64], int channels, float mean[4], float axis[4])
+    {
+        for (int c = 0; c < 4; c++)
+            mean[c] = axis[c] = 0.0f;
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < channels; c++)
+                mean[c] += block[i * 4 + c] / 16.0f;
+
+        float covariance[4][4] = {};
+        for (int i = 0; i < 16; i++)
+            for (int a = 0; a < channels; a++)
+                for (int b = 0; b < channels; b++)
+                    covariance[a][b] += (block[i * 4 + a] - mean[a]) * (block[i * 4 + b] - mean[b]);
+
+        float v[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        for (int iteration = 0; iteration < 8; iteration++)
+        {
+            float next[4] = {}, length = 0.0f;
+            for (int a = 0; a < channels; a++)
+            {
+                for (int b = 0; b < channels; b++)
+                    next[a] += covariance[a][b] * v[b];
+                length = std::max(length, std::fabs(next[a]));
+            }
+            if (length == 0.0f)
+                return; // flat block, axis stays zero
+            for (int a = 0; a < channels; a++)
+                v[a] = next[a] / length;
+        }
+        float length = 0.0f;
+        for (int c = 0; c < channels; c++)
+            length += v[c] * v[c];
+        length = std::sqrt(length);
+        for (int c = 0; c < channels; c++)
+            axis[c] = v[c] / length;
+    }
+
+    // endpoints at the extremes of the block's projection onto its principal axis
+    inline void FitEndpoints(const unsigned char block[64], int channels, float e0[4], float e1[4])
+    {
+        float mean[4], axis[4];
+        PrincipalAxis(block, channels, mean, axis);
+        float minT = 0.0f, maxT = 0.0f;
+        for (int i = 0; i < 16; i++)
+        {
+            float t = 0.0f;
+            for (int c = 0; c < channels; c++)
+                t += (block[i * 4 + c] - mean[c]) * axis[c];
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+        for (int c = 0; c < 4; c++)
+        {
+            e0[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * maxT));
+            e1[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * minT));
+        }
+    }
+
+    // ---------------------------------------------------------------- BC1
+
+    inline uint16_t Pack565(const float color[3])
+    {
+        auto quantize = [](float value, int maximum) {
+            return (int)(std::min(255.0f, std::max(0.0f, value)) * maximum / 255.0f + 0.5f);
+        };
+        return (uint16_t)((quantize(color[0], 31) << 11) | (quantize(color[1], 63) << 5) | quantize(color[2], 31));
+    }
+
+    inline void Unpack565(uint16_t packed, int color[3])
+    {
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    // quantizes the endpoints, picks the best of the four palette entries for every texel and writes the block.
+    // returns the squared error, the chosen indices end up in 'indices'.
+    inline int EncodeBC1Endpoints(const unsigned char block[64], const float e0[3], const float e1[3],
+                                  unsigned char indices[16], unsigned char out[8])
+    {
+        uint16_t c0 = Pack565(e0), c1 = Pack565(e1);
+        if (c0 < c1)
+            std::swap(c0, c1);
+
+        int palette[4][3];
+        Unpack565(c0, palette[0]);
+        Unpack565(c1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        int error = 0;
+        uint32_t bits = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0, bestError = 1 << 30;
+            // c0 == c1 decodes in three colour mode, where only index 0 is safe to use
+            int candidates = c0 == c1 ? 1 : 4;
+            for (int p = 0; p < candidates; p++)
+            {
+                int d = 0;
+                for (int c = 0; c < 3; c++)
+                    d += (block[i * 4 + c] - palette[p][c]) * (block[i * 4 + c] - palette[p][c]);
+                if (d < bestError)
+                {
+                    bestError = d;
+                    best = p;
+                }
+            }
+            error += bestError;
+            indices[i] = (unsigned char)best;
+            bits |= (uint32_t)best << (i * 2);
+        }
+
+        out[0] = (unsigned char)(c0 & 0xFF);
+        out[1] = (unsigned char)(c0 >> 8);
+        out[2] = (unsigned char)(c1 & 0xFF);
+        out[3] = (unsigned char)(c1 >> 8);
+        for (int i = 0; i < 4; i++)
+            out[4 + i] = (unsigned char)(bits >> (i * 8));
+        return error;
+    }
+
+    inline void EncodeBC1Block(const unsigned char block[64], unsigned char out[8])
+    {
+        float e0[4], e1[4];
+        FitEndpoints(block, 3, e0, e1);
+        unsigned char indices[16];
+        int error = EncodeBC1Endpoints(block, e0, e1, indices, out);
+
+        // least squares refit of both endpoints to the chosen indices: every texel is w * a + (1 - w) * b
+        static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+        float aa = 0.0f, bb = 0.0f, ab = 0.0f, ax[3] = {}, bx[3] = {};
+        for (int i = 0; i < 16; i++)
+        {
+            float w = weights[indices[i]];
+            aa += w * w;
+            bb += (1.0f - w) * (1.0f - w);
+            ab += w * (1.0f - w);
+            for (int c = 0; c < 3; c++)
+            {
+                ax[c] += w * block[i * 4 + c];
+                bx[c] += (1.0f - w) * block[i * 4 + c];
+            }
+        }
+        float determinant = aa * bb - ab * ab;
+        if (std::fabs(determinant) < 1e-6f)
+            return;
+        float a[3], b[3];
+        for (int c = 0; c < 3; c++)
+        {
+            a[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+            b[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+        }
+        unsigned char refined[8], refinedIndices[16];
+        if (EncodeBC1Endpoints(block, a, b, refinedIndices, refined) < error)
+            std::memcpy(out, refined, 8);
+    }
+
+    // ---------------------------------------------------------------- BC4 / BC5
+
+    // one channel block, 'stride' bytes between texels. always uses the eight value mode.
+    inline void EncodeBC4Block(const unsigned char *values, int stride, unsigned char out[8])
+    {
+        int minimum = 255, maximum = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            minimum = std::min(minimum, (int)values[i * stride]);
+            maximum = std::max(maximum, (int)values[i * stride]);
+        }
+        out[0] = (unsigned char)maximum;
+        out[1] = (unsigned char)minimum;
+
+        int palette[8] = { maximum, minimum };
+        for (int i = 2; i < 8; i++)
+            palette[i] = ((8 - i) * maximum + (i - 1) * minimum) / 7;
+
+        uint64_t bits = 0;
+        if (maximum != minimum)
+        {
+            for (int i = 0; i < 16; i++)
+            {
+                int best = 0, bestError = 256;
+                for (int p = 0; p < 8; p++)
+                {
+                    int d = std::abs(values[i * stride] - palette[p]);
+                    if (d < bestError)
+                    {
+                        bestError = d;
+                        best = p;
+                    }
+                }
+                bits |= (uint64_t)best << (i * 3);
+            }
+        }
+        for (int i = 0; i < 6; i++)
+            out[2 + i] = (unsigned char)(bits >> (i * 8));
+    }
+
+    inline void EncodeBC3Block(const unsigned char block[64], unsigned char out[16])
+    {
+        EncodeBC4Block(block + 3, 4, out);
+        EncodeBC1Block(block, out + 8);
+    }
+
+    inline void EncodeBC5Block(const unsigned char block[64], unsigned char out[16])
+    {
+        EncodeBC4Block(block, 4, out);
+        EncodeBC4Block(block + 1, 4, out + 8);
+    }
+
+    // ---------------------------------------------------------------- BC7 (mode 6)
+
+    struct BitWriter {
+        unsigned char *out;
+        int position;
+
+        void Write(uint32_t value, int bits)
+        {
+            for (int i = 0; i < bits; i++, position++)
+                if ((value >> i) & 1)
+                    out[position >> 3] |= (unsigned char)(1 << (position & 7));
+        }
+    };
+
+    // 7-bit endpoint plus shared p-bit: picks the p-bit that reproduces the endpoint best
+    inline void QuantizeBC7Endpoint(const float endpoint[4], int quantized[4], int &pBit)
+    {
+        int bestError = 1 << 30;
+        for (int p = 0; p < 2; p++)
+        {
+            int q[4], error = 0;
+            for (int c = 0; c < 4; c++)
+            {
+                q[c] = std::min(127, std::max(0, (int)std::floor((endpoint[c] - p) / 2.0f + 0.5f)));
+                int d = ((q[c] << 1) | p) - (int)(endpoint[c] + 0.5f);
+                error += d * d;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                pBit = p;
+                std::memcpy(quantized, q, sizeof(q));
+            }
+        }
+    }
+
+    inline void EncodeBC7Block(const unsigned char block[64], unsigned char out[16])
+    {
+        static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        float e0[4], e1[4];
+        FitEndpoints(block, 4, e0, e1);
+        int q0[4], q1[4], p0, p1;
+        QuantizeBC7Endpoint(e0, q0, p0);
+        QuantizeBC7Endpoint(e1, q1, p1);
+
+        int palette[16][4];
+        for (int c = 0; c < 4; c++)
+        {
+            int d0 = (q0[c] << 1) | p0, d1 = (q1[c] << 1) | p1;
+            for (int i = 0; i < 16; i++)
+                palette[i][c] = ((64 - weights[i]) * d0 + weights[i] * d1 + 32) >> 6;
+        }
+
+        int indices[16];
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0, bestError = 1 << 30;
+            for (int p = 0; p < 16; p++)
+            {
+                int d = 0;
+                for (int c = 0; c < 4; c++)
+                    d += (block[i * 4 + c] - palette[p][c]) * (block[i * 4 + c] - palette[p][c]);
+                if (d < bestError)
+                {
+                    bestError = d;
+                    best = p;
+                }
+            }
+            indices[i] = best;
+        }
+        // the first index is stored with its top bit implied zero, swap the endpoints if it is set
+        if (indices[0] & 8)
+        {
+            std::swap(q0, q1);
+            std::swap(p0, p1);
+            for (int i = 0; i < 16; i++)
+                indices[i] = 15 - indices[i];
+        }
+
+        std::memset(out, 0, 16);
+        BitWriter writer = { out, 0 };
+        writer.Write(1 << 6, 7);
+        for (int c = 0; c < 4; c++)
+        {
+            writer.Write((uint32_t)q0[c], 7);
+            writer.Write((uint32_t)q1[c], 7);
+        }
+        writer.Write((uint32_t)p0, 1);
+        writer.Write((uint32_t)p1, 1);
+        writer.Write((uint32_t)indices[0], 3);
+        for (int i = 1; i < 16; i++)
+            writer.Write((uint32_t)indices[i], 4);
+    }
+
+    // ----------------------------------------------------------------
+
+    // compresses one image into 'out' (CompressedSize bytes)
+    inline void Compress(const Image &image, Format format, unsigned char *out)
+    {
+        int blocksX = (image.width + 3) / 4, blocksY = (image.height + 3) / 4;
+        unsigned int blockBytes = BlockBytes(format);
+        unsigned char block[64];
+        for (int by = 0; by < blocksY; by++)
+        {
+            for (int bx = 0; bx < blocksX; bx++, out += blockBytes)
+            {
+                FetchBlock(image, bx, by, block);
+                switch (format)
+                {
+                    case BC1: EncodeBC1Block(block, out); break;
+                    case BC3: EncodeBC3Block(block, out); break;
+                    case BC4: EncodeBC4Block(block, 4, out); break;
+                    case BC5: EncodeBC5Block(block, out); break;
+                    case BC7: EncodeBC7Block(block, out); break;
+                }
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,341 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/texture_cache.h>
+#include <learnopengl/thread_pool.h>
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Streams textures in without stalling the render thread. Image files are decoded on the worker pool; the
+// render thread copies finished images into a small ring of pixel buffer objects and issues the texture
+// upload from there, so the driver can DMA the pixels asynchronously. Every ring slot is guarded by a fence
+// and only reused once the GPU has consumed it; Update() polls those fences and never waits on them.
+//
+// Requested textures get their GL name immediately and hold a transparent 1x1 placeholder until the real
+// image lands, so anything that alpha-tests against them simply doesn't show up for the first few frames.
+//
+// 2D textures are uploaded block compressed with their precomputed mip chain. The first start transcodes
+// them on the workers and writes the result to the texture cache, later starts just map the cached file.
+class TextureStreamer
+{
+public:
+    TextureStreamer(ThreadPool &pool, unsigned int ringSize = 4, size_t uploadBudget = 32 * 1024 * 1024)
+            : pool(pool), uploadBudget(uploadBudget), decoding(0), pendingJobs(0), compressedBytes(0), uncompressedBytes(0)
+    {
+        // BPTC (BC7) is core since 4.2, older contexts get BC3 for textures with alpha
+        allowBC7 = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 2);
+        // BC1/BC3 are an extension everywhere, without it those textures are uploaded uncompressed
+        allowS3TC = GLAD_GL_EXT_texture_compression_s3tc != 0;
+        ring.resize(ringSize);
+        for (Slot &slot : ring)
+        {
+            glGenBuffers(1, &slot.buffer);
+            slot.capacity = 0;
+            slot.fence = 0;
+        }
+    }
+
+    ~TextureStreamer()
+    {
+        // workers still reference this object, let the outstanding decodes finish first
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            decodeFinished.wait(lock, [this] { return decoding == 0; });
+        }
+        for (Slot &slot : ring)
+        {
+            if (slot.fence)
+                glDeleteSync(slot.fence);
+            glDeleteBuffers(1, &slot.buffer);
+        }
+    }
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // returns a texture name right away and queues decoding of 'path' on the worker pool.
+    // normal maps are compressed to two channels (BC5), the shader has to rebuild z.
+    unsigned int Request(const std::string &path, bool normalMap = false)
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        uploadPlaceholder(GL_TEXTURE_2D);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        queueDecode(textureID, GL_TEXTURE_2D, GL_TEXTURE_2D, path, true, normalMap);
+        return textureID;
+    }
+
+    // same for a cubemap, faces in +X, -X, +Y, -Y, +Z, -Z order. all six faces decode in parallel.
+    unsigned int RequestCubemap(const std::vector<std::string> &faces)
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+        for (unsigned int i = 0; i < faces.size(); i++)
+            uploadPlaceholder(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+        for (unsigned int i = 0; i < faces.size(); i++)
+            queueDecode(textureID, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, faces[i], false, false);
+        return textureID;
+    }
+
+    // call once per frame on the GL thread. recycles ring slots whose fence has signalled and uploads as many
+    // decoded images as fit into free slots and the per frame byte budget.
+    void Update()
+    {
+        for (Slot &slot : ring)
+        {
+            if (slot.fence && glClientWaitSync(slot.fence, 0, 0) != GL_TIMEOUT_EXPIRED)
+            {
+                glDeleteSync(slot.fence);
+                slot.fence = 0;
+            }
+        }
+
+        size_t uploaded = 0;
+        bool boundPixelBuffer = false;
+        while (uploaded < uploadBudget)
+        {
+            Slot *slot = freeSlot();
+            if (!slot)
+                break;
+
+            Decoded image;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (decoded.empty())
+                    break;
+                image = std::move(decoded.front());
+                decoded.pop_front();
+            }
+            if (!image.pixels && !image.compressed.data)
+            {
+                pendingJobs--;
+                std::cout << "Texture failed to load at path: " << image.job.path << std::endl;
+                continue;
+            }
+
+            GLsizeiptr size = image.compressed.data ? (GLsizeiptr)image.compressed.dataSize
+                                                    : (GLsizeiptr)image.width * image.height * image.components;
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->buffer);
+            boundPixelBuffer = true;
+            if (size > slot->capacity)
+            {
+                glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+                slot->capacity = size;
+            }
+            void *staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            if (!staging)
+            {
+                // the image goes back to the front of the queue and is retried next frame
+                std::lock_guard<std::mutex> lock(mutex);
+                decoded.push_front(std::move(image));
+                break;
+            }
+            pendingJobs--;
+            std::memcpy(staging, image.compressed.data ? image.compressed.data : image.pixels.get(), (size_t)size);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+            glBindTexture(image.job.bindTarget, image.job.texture);
+            if (image.compressed.data)
+                uploadCompressed(image);
+            else
+            {
+                GLenum format = formatFor(image.components);
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+                glTexImage2D(image.job.imageTarget, 0, internalFormatFor(image.components), image.width, image.height, 0, format,
+                             GL_UNSIGNED_BYTE, (const void*)0);
+                if (image.components == 2)
+                {
+                    // grey + alpha: spread the grey over rgb, the second channel is the alpha
+                    static const GLint greyAlpha[4] = { GL_RED, GL_RED, GL_RED, GL_GREEN };
+                    glTexParameteriv(image.job.bindTarget, GL_TEXTURE_SWIZZLE_RGBA, greyAlpha);
+                }
+                if (image.job.bindTarget == GL_TEXTURE_2D)
+                    glGenerateMipmap(GL_TEXTURE_2D);
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            }
+
+            if (image.job.bindTarget == GL_TEXTURE_2D && !hasAlphaChannel(image))
+                opaqueTextures.insert(image.job.texture);
+            slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            uploaded += (size_t)size;
+        }
+        // a bound unpack buffer would turn every later glTexImage2D(..., NULL) into a read from it
+        if (boundPixelBuffer)
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    // true once every requested image has been decoded and handed to GL
+    bool Idle() const { return pendingJobs == 0; }
+
+    // true once 'texture' has been uploaded without an alpha channel, so an alpha test on it never discards.
+    // the placeholder and anything with alpha, even fully opaque alpha in a raw image, don't count.
+    bool Opaque(unsigned int texture) const { return opaqueTextures.count(texture) != 0; }
+
+    // video memory taken by the compressed textures uploaded so far, and what the same textures would take
+    // as uncompressed RGBA8 with mipmaps
+    size_t CompressedBytes() const { return compressedBytes; }
+    size_t UncompressedBytes() const { return uncompressedBytes; }
+
+private:
+    struct Job {
+        unsigned int texture;
+        GLenum bindTarget;
+        GLenum imageTarget;
+        std::string path;
+        bool compress;
+        bool normalMap;
+    };
+
+    struct Decoded {
+        Job job;
+        int width = 0, height = 0, components = 0;
+        std::unique_ptr<unsigned char, void(*)(void*)> pixels{nullptr, stbi_image_free};
+        CompressedTexture compressed;
+    };
+
+    struct Slot {
+        unsigned int buffer;
+        GLsizeiptr capacity;
+        GLsync fence;
+    };
+
+    ThreadPool &pool;
+    size_t uploadBudget;
+    std::vector<Slot> ring;
+    std::mutex mutex;
+    std::condition_variable decodeFinished;
+    std::deque<Decoded> decoded;
+    unsigned int decoding;    // jobs still running on the pool, guarded by mutex
+    unsigned int pendingJobs; // requested but not yet uploaded, only touched on the GL thread
+    bool allowBC7, allowS3TC;
+    size_t compressedBytes, uncompressedBytes;
+    std::unordered_set<unsigned int> opaqueTextures; // see Opaque(), only touched on the GL thread
+
+    void queueDecode(unsigned int texture, GLenum bindTarget, GLenum imageTarget, const std::string &path,
+                     bool compress, bool normalMap)
+    {
+        Job job = { texture, bindTarget, imageTarget, path, compress, normalMap };
+        pendingJobs++;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            decoding++;
+        }
+        pool.Enqueue([this, job] {
+            Decoded image;
+            image.job = job;
+            if (!job.compress || !loadCompressed(job, image.compressed))
+                image.pixels.reset(stbi_load(job.path.c_str(), &image.width, &image.height, &image.components, 0));
+            std::lock_guard<std::mutex> lock(mutex);
+            decoded.push_back(std::move(image));
+            decoding--;
+            decodeFinished.notify_all();
+        });
+    }
+
+    // worker side: maps the cached transcode of the image or creates it. false leaves the image to the
+    // uncompressed path, which also reports it if it can't be decoded at all.
+    bool loadCompressed(const Job &job, CompressedTexture &texture) const
+    {
+        MappedFile source(job.path);
+        if (!source.isOpen())
+            return false;
+        uint64_t sourceHash = TextureCache::HashSource(source);
+        std::string cachePath = TextureCache::PathFor(job.path, job.normalMap);
+        if (TextureCache::Load(cachePath, sourceHash, allowBC7, allowS3TC, texture))
+            return true;
+        if (!TextureCache::Transcode(source, job.normalMap, allowBC7, allowS3TC, texture))
+        {
+            texture = CompressedTexture();
+            return false;
+        }
+        if (!TextureCache::Store(cachePath, sourceHash, texture))
+            std::cout << "Failed to write texture cache for: " << job.path << std::endl;
+        return true;
+    }
+
+    // GL side: every mip level straight out of the bound unpack buffer, nothing generated at runtime
+    void uploadCompressed(const Decoded &image)
+    {
+        const CompressedTexture &texture = image.compressed;
+        for (size_t level = 0; level < texture.levels.size(); level++)
+        {
+            const CompressedTexture::Level &mip = texture.levels[level];
+            glCompressedTexImage2D(image.job.imageTarget, (GLint)level, texture.format, (GLsizei)mip.width, (GLsizei)mip.height, 0,
+                                   (GLsizei)mip.size, (const void*)(uintptr_t)mip.offset);
+        }
+        glTexParameteri(image.job.bindTarget, GL_TEXTURE_MAX_LEVEL, (GLint)texture.levels.size() - 1);
+
+        compressedBytes += texture.dataSize;
+        const CompressedTexture::Level &base = texture.levels.front();
+        uncompressedBytes += (size_t)base.width * base.height * 4 * 4 / 3;
+    }
+
+    // the compressor only picks an alpha format when some texel isn't fully opaque
+    static bool hasAlphaChannel(const Decoded &image)
+    {
+        if (image.compressed.data)
+            return image.compressed.format == TextureCompressor::BC3 || image.compressed.format == TextureCompressor::BC7;
+        return image.components == 2 || image.components == 4;
+    }
+
+    Slot *freeSlot()
+    {
+        for (Slot &slot : ring)
+            if (!slot.fence)
+                return &slot;
+        return nullptr;
+    }
+
+    static GLenum formatFor(int components)
+    {
+        if (components == 1)
+            return GL_RED;
+        if (components == 2)
+            return GL_RG;
+        if (components == 3)
+            return GL_RGB;
+        return GL_RGBA;
+    }
+
+    static GLint internalFormatFor(int components)
+    {
+        if (components == 1)
+            return GL_R8;
+        if (components == 2)
+            return GL_RG8;
+        if (components == 3)
+            return GL_RGB8;
+        return GL_RGBA8;
+    }
+
+    static void uploadPlaceholder(GLenum target)
+    {
+        static const unsigned char transparent[4] = { 0, 0, 0, 0 };
+        glTexImage2D(target, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, transparent);
+    }
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// std140 layouts of the uniform blocks shared by the scene shaders, at fixed binding points so any shader
+// declaring them gets the data without further setup. keep these in sync with the declarations in
+// resources/shaders/uniform_blocks.glsl; vec3s are stored as vec4 since std140 pads them anyway.
+enum UniformBlockBinding : GLuint {
+    FrameBlockBinding = 0,
+    ViewBlockBinding = 1
+};
+
+// the ObjectBlocks are a shader storage buffer with one entry per object, so one draw call can cover many
+// of them. instances find theirs through a second buffer of object indices, at gl_BaseInstance + gl_InstanceID,
+// which lets every mesh of a model draw a different subset of its instances.
+const GLuint ObjectBufferBinding = 4;
+const GLuint ObjectIndexBufferBinding = 5;
+
+struct FrameBlock {
+    glm::vec4 time;       // x: seconds since start, y: frame delta
+    glm::vec4 screenSize; // xy: pixels, zw: 1 / pixels
+};
+
+struct ViewBlock {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 position;   // xyz: camera position
+    glm::vec4 clip;       // x: near plane, y: far plane
+    glm::mat4 inverseViewProjection; // clip space back to world space, for depth reconstruction
+};
+
+// laid out the same under std430, the storage buffer's layout
+struct ObjectBlock {
+    glm::mat4 model;
+    glm::mat4 normalMatrix; // transpose(inverse(model)), as mat4 to dodge std140's mat3 padding
+    glm::vec4 tint;         // rgb: multiplies the albedo, a: free for per instance parameters
+};
+
+inline ObjectBlock MakeObjectBlock(const glm::mat4 &model, const glm::vec4 &tint = glm::vec4(1.0f))
+{
+    return { model, glm::transpose(glm::inverse(model)), tint };
+}
+
+#endif
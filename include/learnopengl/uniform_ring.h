@@ -0,0 +1,174 @@
+#ifndef UNIFORM_RING_H
+#define UNIFORM_RING_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <vector>
+
+// A persistently mapped uniform buffer split into one region per frame in flight. The CPU fills the current
+// region with plain memcpy and binds blocks by offset with glBindBufferRange; a fence per region makes sure a
+// region is only overwritten once the GPU has consumed the frame that used it three frames ago.
+//
+// A region never wraps onto blocks of its own frame: when a frame needs more, every region grows (see Reserve()).
+class UniformRing {
+public:
+    static const unsigned int FramesInFlight = 3;
+
+    explicit UniformRing(size_t bytesPerFrame)
+    {
+        // offsets are also bound as storage buffers, so they satisfy both alignments
+        GLint uniformAlignment = 256, storageAlignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+        GLint alignment = std::max(uniformAlignment, storageAlignment);
+        this->alignment = alignment > 0 ? (size_t)alignment : 256;
+        regionSize = align(bytesPerFrame);
+        createStorage();
+    }
+
+    UniformRing(const UniformRing&) = delete;
+    UniformRing &operator=(const UniformRing&) = delete;
+
+    ~UniformRing()
+    {
+        for (GLsync &fence : fences)
+            if (fence)
+                glDeleteSync(fence);
+        deleteStorage();
+    }
+
+    // moves on to the next region, waiting for the GPU if it is still reading it
+    void BeginFrame()
+    {
+        region = (region + 1) % FramesInFlight;
+        wait(fences[region]);
+        cursor = 0;
+        boundBlocks.clear();
+    }
+
+    // call after the last draw reading this frame's blocks
+    void EndFrame()
+    {
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // copies 'data' into this frame's region and returns its offset in the buffer
+    template<typename T>
+    size_t Write(const T &data)
+    {
+        return Write(&data, sizeof(T));
+    }
+
+    // same for 'size' bytes, e.g. an array read as a shader storage buffer or indirect commands
+    size_t Write(const void *data, size_t size)
+    {
+        size_t offset = Allocate(size);
+        std::memcpy(mapped + offset, data, size);
+        return offset;
+    }
+
+    // reserves 'size' bytes of this frame's region without writing them, for the GPU to fill
+    size_t Allocate(size_t size)
+    {
+        Reserve({ size });
+        size_t offset = region * regionSize + cursor;
+        cursor += align(size);
+        return offset;
+    }
+
+    // makes sure blocks of 'sizes' fit into what is left of this frame's region. if they don't, the ring waits
+    // for the GPU to finish every frame in flight, moves this frame's blocks into a buffer with bigger regions and
+    // binds the ones of Bind() there again. offsets and Buffer() from before a growing Reserve() are stale, so a
+    // pass reserves all it writes before its first write.
+    void Reserve(std::initializer_list<size_t> sizes)
+    {
+        size_t needed = cursor;
+        for (size_t size : sizes)
+            needed += align(size);
+        if (needed <= regionSize)
+            return;
+        size_t grown = regionSize * 2;
+        while (grown < needed)
+            grown *= 2;
+        std::cout << "UNIFORM_RING: growing the frame regions from " << regionSize << " to " << grown << " bytes" << std::endl;
+
+        for (GLsync &fence : fences)
+            wait(fence);
+        std::vector<unsigned char> blocks(mapped + region * regionSize, mapped + region * regionSize + cursor);
+        deleteStorage();
+        regionSize = grown;
+        createStorage();
+        std::memcpy(mapped + region * regionSize, blocks.data(), blocks.size());
+        for (const BoundBlock &block : boundBlocks)
+            glBindBufferRange(GL_UNIFORM_BUFFER, block.binding, buffer, (GLintptr)(region * regionSize + block.offset), block.size);
+    }
+
+    // writes 'data' and binds it to the uniform block binding point 'binding'
+    template<typename T>
+    void Bind(GLuint binding, const T &data)
+    {
+        size_t offset = Write(data);
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, (GLintptr)offset, sizeof(T));
+        boundBlocks.push_back({ binding, offset - region * regionSize, sizeof(T) });
+    }
+
+    // the GL buffer the offsets returned by Write() point into
+    unsigned int Buffer() const { return buffer; }
+
+private:
+    // a block bound by Bind() this frame, offset from the start of the region
+    struct BoundBlock {
+        GLuint binding;
+        size_t offset;
+        size_t size;
+    };
+
+    unsigned int buffer = 0;
+    unsigned char *mapped = nullptr;
+    size_t alignment = 256, regionSize = 0, cursor = 0;
+    unsigned int region = 0;
+    GLsync fences[FramesInFlight] = {};
+    std::vector<BoundBlock> boundBlocks;
+
+    size_t align(size_t size) const
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    void createStorage()
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferStorage(GL_UNIFORM_BUFFER, regionSize * FramesInFlight, nullptr, flags);
+        mapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, regionSize * FramesInFlight, flags);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    // draws already queued on the old buffer keep it alive until they are done
+    void deleteStorage()
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+    }
+
+    static void wait(GLsync &fence)
+    {
+        if (!fence)
+            return;
+        GLbitfield waitFlags = 0;
+        while (glClientWaitSync(fence, waitFlags, 1000000) == GL_TIMEOUT_EXPIRED)
+            waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        glDeleteSync(fence);
+        fence = 0;
+    }
+};
+
+#endif
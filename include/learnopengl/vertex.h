@@ -0,0 +1,75 @@
+#ifndef VERTEX_H
+#define VERTEX_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <cmath>
+#include <cstdint>
+
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+    // tangent
+    glm::vec3 Tangent;
+    // bitangent
+    glm::vec3 Bitangent;
+};
+
+// What a Vertex gets uploaded as: 24 bytes instead of 56, the position as a plain vec3 in a stream of its own
+// (see GeometryPool) and the rest packed here. Normal and tangent are 10 bits per component, the tangent's w
+// holds the bitangent sign so shaders rebuild it as cross(normal, tangent.xyz) * tangent.w.
+struct PackedVertex {
+    uint32_t  Normal;    // GL_INT_2_10_10_10_REV, normalized
+    uint32_t  Tangent;   // GL_INT_2_10_10_10_REV, normalized
+    uint32_t  TexCoords; // two half floats
+};
+
+// same, but with float texture coordinates for meshes tiling their textures so often that half floats would
+// no longer address single texels
+struct PackedVertexWideUV {
+    uint32_t  Normal;
+    uint32_t  Tangent;
+    glm::vec2 TexCoords;
+};
+
+// half floats keep about 1/1024 precision below 2.0, which is still a texel of a 1K texture
+const float HalfTexCoordLimit = 2.0f;
+
+// meshes without texture coordinates have no tangent frame, they get (0, 0, 0, 1) so the packed bits and
+// with them the mesh cache stay the same from run to run
+template<typename PackedType>
+inline void PackAttributes(const Vertex &vertex, PackedType &packed)
+{
+    packed.Normal = glm::packSnorm3x10_1x2(glm::vec4(vertex.Normal, 0.0f));
+    float tangentLength2 = glm::dot(vertex.Tangent, vertex.Tangent);
+    if (!(tangentLength2 > 0.0f) || !std::isfinite(tangentLength2))
+    {
+        packed.Tangent = glm::packSnorm3x10_1x2(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        return;
+    }
+    float handedness = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+    packed.Tangent = glm::packSnorm3x10_1x2(glm::vec4(vertex.Tangent, handedness));
+}
+
+inline PackedVertex PackVertex(const Vertex &vertex)
+{
+    PackedVertex packed;
+    PackAttributes(vertex, packed);
+    packed.TexCoords = glm::packHalf2x16(vertex.TexCoords);
+    return packed;
+}
+
+inline PackedVertexWideUV PackVertexWideUV(const Vertex &vertex)
+{
+    PackedVertexWideUV packed;
+    PackAttributes(vertex, packed);
+    packed.TexCoords = vertex.TexCoords;
+    return packed;
+}
+
+#endif
@@ -1,4 +1,4 @@
-#version 330 core
+#version 460 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
@@ -6,15 +6,19 @@ layout (location = 2) in vec2 aTexCoords;
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+flat out vec3 Tint;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "uniform_blocks.glsl"
+
+// depth_prepass.vs computes the same position, the depth test against it is GL_EQUAL
+invariant gl_Position;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    Object object = objects[objectIndices[gl_BaseInstance + gl_InstanceID]];
+    FragPos = vec3(object.model * vec4(aPos, 1.0));
+    Normal = mat3(object.normalMatrix) * aNormal;
     TexCoords = aTexCoords;
-    gl_Position = projection * view * vec4(FragPos, 1.0);
-}
\ No newline at end of file
+    Tint = object.tint.rgb;
+    gl_Position = viewProjection * vec4(FragPos, 1.0);
+}
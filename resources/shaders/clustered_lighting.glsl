@@ -0,0 +1,108 @@
+// clustered Blinn-Phong / Phong lighting shared by the forward and the deferred path.
+// compile time switches: BLINN, SPOTLIGHT, BLOOM_OUTPUT, CLUSTER_HEATMAP, see ShaderFeature.
+#include "uniform_blocks.glsl"
+#include "lights.glsl"
+
+// lights per cluster, filled by cluster_cull.comp. see LightClusters for the layout. a count above
+// MAX_LIGHTS_PER_CLUSTER means the rest of the cluster's lights didn't fit into its list.
+layout (std430, binding = 2) readonly buffer ClusterLightCounts {
+    uint clusterLightCount[];
+};
+
+layout (std430, binding = 3) readonly buffer ClusterLightIndices {
+    uint clusterLightIndex[];
+};
+
+// what the material gives for this fragment, sampled once
+struct Surface {
+    vec3 diffuse;
+    vec3 specular;
+};
+
+uint ClusterIndex(vec3 fragPos)
+{
+    float depth = -(view * vec4(fragPos, 1.0)).z;
+    uint slice = uint(max(log(depth / clip.x) / log(clip.y / clip.x) * float(CLUSTER_GRID.z), 0.0));
+    uvec2 tile = uvec2(gl_FragCoord.xy * screenSize.zw * vec2(CLUSTER_GRID.xy));
+    tile = min(tile, CLUSTER_GRID.xy - 1u);
+    slice = min(slice, CLUSTER_GRID.z - 1u);
+    return tile.x + tile.y * CLUSTER_GRID.x + slice * CLUSTER_GRID.x * CLUSTER_GRID.y;
+}
+
+// blue (few lights) over green to red (32 or more), magenta where lights were dropped
+vec3 HeatmapColor(uint count)
+{
+    if (count > MAX_LIGHTS_PER_CLUSTER)
+        return vec3(1.0, 0.0, 1.0);
+    float t = clamp(float(count) / 32.0, 0.0, 1.0);
+    return t < 0.5 ? mix(vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 0.0), t * 2.0) : mix(vec3(0.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0), t * 2.0 - 1.0);
+}
+
+// ambient + diffuse + specular of one light arriving from lightDir
+vec3 CalcLight(vec3 lightDir, vec3 ambient, vec3 diffuse, vec3 specular, Surface surface, vec3 normal, vec3 viewDir)
+{
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+#ifdef BLINN
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
+#else
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 8.0);
+#endif
+    // combine results
+    return ambient * surface.diffuse + diffuse * diff * surface.diffuse + specular * spec * surface.specular;
+}
+
+// Calculates directional light
+vec3 CalcDirLight(DirLight light, Surface surface, vec3 normal, vec3 viewDir)
+{
+    vec3 lightDir = normalize(-light.direction.xyz);
+    return CalcLight(lightDir, light.ambient.rgb, light.diffuse.rgb, light.specular.rgb, surface, normal, viewDir);
+}
+
+// calculates the color of a point or spot light
+vec3 CalcLocalLight(Light light, Surface surface, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 toLight = light.position.xyz - fragPos;
+    vec3 lightDir = normalize(toLight);
+    // attenuation
+    float distance = length(toLight);
+    float attenuation = 1.0 / (light.attenuation.x + light.attenuation.y * distance + light.attenuation.z * (distance * distance));
+    // fade out towards the range the light was culled with
+    float falloff = clamp(1.0 - pow(distance / light.attenuation.w, 4.0), 0.0, 1.0);
+    attenuation *= falloff * falloff;
+#ifdef SPOTLIGHT
+    // spotlight intensity
+    if (uint(light.position.w) == SPOT_LIGHT)
+    {
+        float theta = dot(lightDir, normalize(-light.direction.xyz));
+        float epsilon = light.cone.x - light.cone.y;
+        attenuation *= clamp((theta - light.cone.y) / epsilon, 0.0, 1.0);
+    }
+#endif
+    return attenuation * CalcLight(lightDir, light.ambient.rgb, light.diffuse.rgb, light.specular.rgb, surface, normal, viewDir);
+}
+
+// the directional light plus every light of the fragment's cluster
+vec3 ShadeSurface(Surface surface, vec3 normal, vec3 fragPos)
+{
+    vec3 viewDir = normalize(viewPosition.xyz - fragPos);
+    vec3 result = CalcDirLight(dirLight, surface, normal, viewDir);
+    uint cluster = ClusterIndex(fragPos);
+    uint clusterLights = clusterLightCount[cluster];
+    for (uint i = 0u; i < min(clusterLights, MAX_LIGHTS_PER_CLUSTER); i++)
+        result += CalcLocalLight(lights[clusterLightIndex[cluster * MAX_LIGHTS_PER_CLUSTER + i]], surface, normal, fragPos, viewDir);
+#ifdef CLUSTER_HEATMAP
+    result = mix(result, HeatmapColor(clusterLights), 0.6);
+#endif
+    return result;
+}
+
+// what goes into the bloom target: the colour where it is brighter than 1, black elsewhere
+vec4 BrightPart(vec3 color)
+{
+    float brightness = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    return brightness > 1.0 ? vec4(color, 1.0) : vec4(0.0, 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,47 @@
+#version 460 core
+// lighting pass of the deferred path: one fullscreen quad shading every pixel once from the G-buffer, with
+// the same clustered lights and light functions as 2.model_lighting.fs. writes both HDR targets like it.
+layout (location = 0) out vec4 FragColor;
+#ifdef BLOOM_OUTPUT
+layout (location = 1) out vec4 BrightColor;
+#endif
+
+#include "clustered_lighting.glsl"
+
+in vec2 TexCoords;
+
+// see GBuffer
+layout (binding = 0) uniform sampler2D gAlbedoSpecular;
+layout (binding = 1) uniform sampler2D gNormal;
+layout (binding = 2) uniform sampler2D gDepth;
+
+vec3 DecodeNormal(vec2 encoded)
+{
+    vec2 f = encoded * 2.0 - 1.0;
+    vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    float depth = texture(gDepth, TexCoords).r;
+    if (depth == 1.0) // background, the skybox goes there
+        discard;
+    vec4 clipPosition = vec4(vec3(TexCoords, depth) * 2.0 - 1.0, 1.0);
+    vec4 worldPosition = inverseViewProjection * clipPosition;
+    vec3 fragPos = worldPosition.xyz / worldPosition.w;
+
+    vec4 albedoSpecular = texture(gAlbedoSpecular, TexCoords);
+    Surface surface;
+    surface.diffuse = albedoSpecular.rgb;
+    surface.specular = vec3(albedoSpecular.a);
+    vec3 normal = DecodeNormal(texture(gNormal, TexCoords).rg);
+
+    vec3 result = ShadeSurface(surface, normal, fragPos);
+#ifdef BLOOM_OUTPUT
+    BrightColor = BrightPart(result);
+#endif
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,18 @@
+#version 460 core
+// depth pre-pass: no colour output. alpha tested materials drop the fragments the scene shaders discard.
+#ifdef ALPHA_TEST
+struct Material {
+    sampler2D texture_diffuse1;
+};
+in vec2 TexCoords;
+
+uniform Material material;
+#endif
+
+void main()
+{
+#ifdef ALPHA_TEST
+    if(texture(material.texture_diffuse1, TexCoords).a < 0.2)
+        discard;
+#endif
+}
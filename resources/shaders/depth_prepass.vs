@@ -0,0 +1,23 @@
+#version 460 core
+// depth pre-pass: positions only, alpha tested materials also need their texture coordinates
+layout (location = 0) in vec3 aPos;
+#ifdef ALPHA_TEST
+layout (location = 2) in vec2 aTexCoords;
+
+out vec2 TexCoords;
+#endif
+
+#include "uniform_blocks.glsl"
+
+// the same operations as 2.model_lighting.vs, so the main pass can test for GL_EQUAL depth
+invariant gl_Position;
+
+void main()
+{
+    Object object = objects[objectIndices[gl_BaseInstance + gl_InstanceID]];
+    vec3 FragPos = vec3(object.model * vec4(aPos, 1.0));
+#ifdef ALPHA_TEST
+    TexCoords = aTexCoords;
+#endif
+    gl_Position = viewProjection * vec4(FragPos, 1.0);
+}
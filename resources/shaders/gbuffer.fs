@@ -0,0 +1,40 @@
+#version 460 core
+// geometry pass of the deferred path, see GBuffer
+layout (location = 0) out vec4 AlbedoSpecular;
+layout (location = 1) out vec2 EncodedNormal;
+
+struct Material {
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+};
+in vec2 TexCoords;
+in vec3 Normal;
+in vec3 FragPos;
+flat in vec3 Tint;
+
+uniform Material material;
+
+// octahedral normal encoding: the unit sphere folded onto a square, mapped to [0, 1]
+vec2 OctWrap(vec2 v)
+{
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 EncodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    n.xy = n.z >= 0.0 ? n.xy : OctWrap(n.xy);
+    return n.xy * 0.5 + 0.5;
+}
+
+void main()
+{
+    vec4 texColor = texture(material.texture_diffuse1, TexCoords);
+#ifdef ALPHA_TEST
+    if(texColor.a < 0.2)
+        discard;
+#endif
+    vec3 specular = texture(material.texture_specular1, TexCoords).rgb;
+    AlbedoSpecular = vec4(texColor.rgb * Tint, max(specular.r, max(specular.g, specular.b)));
+    EncodedNormal = EncodeNormal(normalize(Normal));
+}
@@ -0,0 +1,30 @@
+// the light storage buffer of light_buffer.h and the cluster grid of light_clusters.h
+const uint POINT_LIGHT = 0u;
+const uint SPOT_LIGHT = 1u;
+
+// see GpuLight in light_buffer.h
+struct Light {
+    vec4 position;    // xyz, w: type
+    vec4 direction;
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+    vec4 attenuation; // constant, linear, quadratic, range
+    vec4 cone;        // cos of the inner and outer cone
+};
+
+struct DirLight {
+    vec4 direction;
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+};
+
+layout (std430, binding = 0) readonly buffer Lights {
+    DirLight dirLight;
+    uvec4 lightCount;
+    Light lights[];
+};
+
+const uvec3 CLUSTER_GRID = uvec3(16u, 9u, 24u);
+#define MAX_LIGHTS_PER_CLUSTER 256u
@@ -0,0 +1,34 @@
+// the uniform blocks and the object buffer of uniform_blocks.h, at their fixed binding points
+layout (std140, binding = 0) uniform Frame {
+    vec4 time;       // x: seconds since start, y: frame delta
+    vec4 screenSize; // xy: pixels, zw: 1 / pixels
+};
+
+layout (std140, binding = 1) uniform View {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 viewPosition;
+    vec4 clip;       // x: near plane, y: far plane
+    mat4 inverseViewProjection;
+};
+
+// one per object, see ObjectIndices
+struct Object {
+    mat4 model;
+    mat4 normalMatrix;
+    vec4 tint;       // rgb: albedo multiplier
+};
+
+layout (std430, binding = 4) readonly buffer Objects {
+    Object objects[];
+};
+
+// the object of each drawn instance, index with gl_BaseInstance + gl_InstanceID. the culling pass that fills
+// them defines OBJECT_INDEX_ACCESS before including this file.
+#ifndef OBJECT_INDEX_ACCESS
+#define OBJECT_INDEX_ACCESS readonly
+#endif
+layout (std430, binding = 5) OBJECT_INDEX_ACCESS buffer ObjectIndices {
+    uint objectIndices[];
+};
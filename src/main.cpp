@@ -10,15 +10,39 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <learnopengl/filesystem.h>
+#include <learnopengl/gbuffer.h>
+#include <learnopengl/light_buffer.h>
+#include <learnopengl/light_clusters.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/shader_variants.h>
 #include <learnopengl/camera.h>
+#include <learnopengl/gpu_culler.h>
+#include <learnopengl/hiz_pyramid.h>
 #include <learnopengl/model.h>
-
+#include <learnopengl/occlusion_culler.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/texture_streamer.h>
+#include <learnopengl/thread_pool.h>
+#include <learnopengl/uniform_blocks.h>
+#include <learnopengl/uniform_ring.h>
+
+#include <future>
 #include <iostream>
+#include <random>
 
 void renderQuad();
 
-unsigned int loadCubemap(vector<std::string> faces);
+std::vector<PointLight> ScatterLights(int count);
+
+// an extra copy of the tree: where on the island's unit disk, its rotation, size and colour variation
+struct TreeInstance {
+    glm::vec2 position;
+    float yaw;
+    float scale;
+    glm::vec4 tint;
+};
+
+std::vector<TreeInstance> ScatterTrees(int count);
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 
@@ -44,39 +68,6 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-struct PointLight {
-    glm::vec3 position;
-    glm::vec3 ambient;
-    glm::vec3 diffuse;
-    glm::vec3 specular;
-
-    float constant;
-    float linear;
-    float quadratic;
-};
-
-struct SpotLight {
-    glm::vec3 position;
-    glm::vec3 direction;
-    float cutOff;
-    float outerCutOff;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    glm::vec3 ambient;
-    glm::vec3 diffuse;
-    glm::vec3 specular;
-};
-
-struct DirLight {
-    glm::vec3 direction;
-    glm::vec3 ambient;
-    glm::vec3 diffuse;
-    glm::vec3 specular;
-};
-
 struct ProgramState {
     glm::vec3 clearColor = glm::vec3(0);
     bool ImGuiEnabled = false;
@@ -105,6 +96,14 @@ struct ProgramState {
     bool isCamSpotLightEnabled = false;
     bool hdr = true;
     bool bloom = true;
+    float lodPixelError = 1.0f;
+    int scatteredLightCount = 0;
+    int extraTreeCount = 0;
+    bool occlusionCulling = true;
+    bool gpuCulling = false;
+    bool depthPrepass = false;
+    bool clusterHeatmap = false;
+    bool deferred = false;
     PointLight eyePointLight1;
     PointLight eyePointLight2;
     PointLight candlePointLight;
@@ -210,7 +209,10 @@ void ProgramState::LoadFromFile(std::string filename) {
 
 ProgramState *programState;
 
-void DrawImGui(ProgramState *programState);
+void DrawImGui(ProgramState *programState, const std::vector<std::pair<const char*, const Model*>> &models, const RenderStats &renderStats,
+               const TextureStreamer &textureStreamer, const LightClusters &lightClusters);
+
+void RunScene(GLFWwindow *window);
 
 int main() {
     // glfw: initialize and configure
@@ -267,6 +269,24 @@ int main() {
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 460 core");
 
+    RunScene(window);
+    // the pool is a static and would outlive the context
+    GeometryPool::Instance().Shutdown();
+
+    programState->SaveToFile("resources/program_state.txt");
+    delete programState;
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImGui::DestroyContext();
+    // glfw: terminate, clearing all previously allocated GLFW resources.
+    // ------------------------------------------------------------------
+    glfwTerminate();
+    return 0;
+}
+
+// the scene and its render loop. every object owning GL names is a local here, so all of them are destroyed
+// while the context is still current.
+void RunScene(GLFWwindow *window) {
     // configure global opengl state
     // -----------------------------
     glEnable(GL_DEPTH_TEST);
@@ -275,10 +295,19 @@ int main() {
 
     // build and compile shaders
     // -------------------------
-    Shader ourShader("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
+    // the scene shaders come as compile time variants over the ShaderFeatures they support
+    ShaderVariants forwardShaders("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs",
+                                  ShaderBlinn | ShaderSpotLight | ShaderBloomOutput | ShaderAlphaTest | ShaderClusterHeatmap);
     Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
     Shader hdrShader("resources/shaders/hdr.vs", "resources/shaders/hdr.fs");
     Shader blurShader("resources/shaders/blur.vs", "resources/shaders/blur.fs");
+    // deferred path: geometry pass into the G-buffer, then one lighting pass into hdrFBO
+    ShaderVariants gBufferShaders("resources/shaders/2.model_lighting.vs", "resources/shaders/gbuffer.fs", ShaderAlphaTest);
+    // depth only, for either path's pre-pass
+    ShaderVariants depthPrepassShaders("resources/shaders/depth_prepass.vs", "resources/shaders/depth_prepass.fs", ShaderAlphaTest);
+    ShaderVariants deferredLightingShaders("resources/shaders/hdr.vs", "resources/shaders/deferred_lighting.fs",
+                                           ShaderBlinn | ShaderSpotLight | ShaderBloomOutput | ShaderClusterHeatmap);
+    GBuffer gBuffer(SCR_WIDTH, SCR_HEIGHT);
 
     unsigned int hdrFBO;
     glGenFramebuffers(1, &hdrFBO);
@@ -297,12 +326,16 @@ int main() {
         // attach texture to framebuffer
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffers[i], 0);
     }
-    // create and attach depth buffer (renderbuffer)
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
+    // create and attach depth buffer (a texture, the hierarchical-Z pyramid is built from it)
+    unsigned int depthTexture;
+    glGenTextures(1, &depthTexture);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, SCR_WIDTH, SCR_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL); // same format as the G-buffer depth, for blitting
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
     // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
     unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
     glDrawBuffers(2, attachments);
@@ -335,36 +368,57 @@ int main() {
 
     // load models
     // -----------
-    Model islandModel("resources/objects/island/island.obj");
+    // the CPU side of every import (parsing, vertex conversion, index flattening) runs on the worker pool,
+    // only the GL buffer and texture creation happens here on the context thread as results come in.
+    // both eyeballs resolve to the same asset, so it is imported and uploaded once and shared.
+    ThreadPool loaderPool;
+    // textures decode on the same pool and are uploaded through a PBO ring from inside the render loop
+    TextureStreamer textureStreamer(loaderPool);
+    auto islandImport = loaderPool.Enqueue(Model::Import, std::string("resources/objects/island/island.obj"));
+    auto eyeImport = loaderPool.Enqueue(Model::Import, std::string("resources/objects/eyeball/eyeball.obj"));
+    auto lighthouseImport = loaderPool.Enqueue(Model::Import, std::string("resources/objects/lighthouse/lighthouse.obj"));
+    auto shedImport = loaderPool.Enqueue(Model::Import, std::string("resources/objects/shed/shed.obj"));
+    auto picnicTableImport = loaderPool.Enqueue(Model::Import, std::string("resources/objects/picnic table/picnic_table.obj"));
+    auto treeImport = loaderPool.Enqueue(Model::Import, std::string("resources/objects/tree/tree.obj"));
+    auto roundTableImport = loaderPool.Enqueue(Model::Import, std::string("resources/objects/round-table/round_table.obj"));
+    auto candleImport = loaderPool.Enqueue(Model::Import, std::string("resources/objects/candle/candle.obj"));
+    auto firewoodImport = loaderPool.Enqueue(Model::Import, std::string("resources/objects/firewood/firewood.obj"));
+
+    Model islandModel(*islandImport.get(), &textureStreamer);
     islandModel.SetShaderTextureNamePrefix("material.");
 
-    Model eyeModel1("resources/objects/eyeball/eyeball.obj");
-    eyeModel1.SetShaderTextureNamePrefix("material.");
-
-    Model eyeModel2("resources/objects/eyeball/eyeball.obj");
-    eyeModel2.SetShaderTextureNamePrefix("material.");
+    // both eyeballs are instances of one model
+    Model eyeModel(*eyeImport.get(), &textureStreamer);
+    eyeModel.SetShaderTextureNamePrefix("material.");
 
-    Model lighthouseModel("resources/objects/lighthouse/lighthouse.obj");
+    Model lighthouseModel(*lighthouseImport.get(), &textureStreamer);
     lighthouseModel.SetShaderTextureNamePrefix("material.");
 
-    Model shedModel("resources/objects/shed/shed.obj");
+    Model shedModel(*shedImport.get(), &textureStreamer);
     shedModel.SetShaderTextureNamePrefix("material.");
 
-    Model picnicTableModel("resources/objects/picnic table/picnic_table.obj");
+    Model picnicTableModel(*picnicTableImport.get(), &textureStreamer);
     picnicTableModel.SetShaderTextureNamePrefix("material.");
 
-    Model treeModel("resources/objects/tree/tree.obj");
+    Model treeModel(*treeImport.get(), &textureStreamer);
     treeModel.SetShaderTextureNamePrefix("material.");
 
-    Model roundTableModel("resources/objects/round-table/round_table.obj");
+    Model roundTableModel(*roundTableImport.get(), &textureStreamer);
     roundTableModel.SetShaderTextureNamePrefix("material.");
 
-    Model candleModel("resources/objects/candle/candle.obj");
+    Model candleModel(*candleImport.get(), &textureStreamer);
     candleModel.SetShaderTextureNamePrefix("material.");
 
-    Model firewoodModel("resources/objects/firewood/firewood.obj");
+    Model firewoodModel(*firewoodImport.get(), &textureStreamer);
     firewoodModel.SetShaderTextureNamePrefix("material.");
 
+    // for the LOD panel
+    std::vector<std::pair<const char*, const Model*>> sceneModels = {
+            { "Island", &islandModel }, { "Eyeballs", &eyeModel },
+            { "Lighthouse", &lighthouseModel }, { "Shed", &shedModel }, { "Picnic table", &picnicTableModel },
+            { "Tree", &treeModel }, { "Round table", &roundTableModel }, { "Candle", &candleModel },
+            { "Firewood", &firewoodModel } };
+
     //Eye point light 1
     PointLight& eyePointLight1 = programState->eyePointLight1;
     eyePointLight1.position = glm::vec3(4.0f, 4.0, 0.0);
@@ -488,7 +542,7 @@ int main() {
                     FileSystem::getPath("resources/textures/skybox/skybox_front.png"),
                     FileSystem::getPath("resources/textures/skybox/skybox_back.png")
             };
-    unsigned int cubemapTexture = loadCubemap(faces);
+    unsigned int cubemapTexture = textureStreamer.RequestCubemap(faces);
 
     hdrShader.use();
     hdrShader.setInt("scene", 0);
@@ -499,6 +553,29 @@ int main() {
     // draw in wireframe
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
+    // frame and view uniform blocks, per object data and indirect commands are written once a frame into the ring
+    UniformRing uniformRing(4 * 1024 * 1024);
+    // the scene's draws are queued, sorted by state and depth and issued without redundant binds
+    RenderQueue renderQueue(uniformRing);
+    RenderState renderState;
+    OcclusionCuller occlusionCuller;
+    // culling on the GPU instead, against the depth of the frame before
+    HiZPyramid hiZPyramid("resources/shaders/hiz_build.comp", SCR_WIDTH, SCR_HEIGHT);
+    GpuCuller gpuCuller("resources/shaders/instance_cull.comp", hiZPyramid);
+    // fragment shader invocations of the scene pass, one query per frame in flight: a result is read when its
+    // query comes around again, by then the ring has waited for that frame and nothing stalls
+    unsigned int fragmentQueries[UniformRing::FramesInFlight];
+    glGenQueries(UniformRing::FramesInFlight, fragmentQueries);
+    unsigned int fragmentQueryFrame = 0, fragmentInvocations = 0;
+    std::vector<TreeInstance> extraTrees;
+    std::vector<glm::mat4> treeTransforms;
+    std::vector<glm::vec4> treeTints;
+
+    // every light of the scene, rebuilt each frame, and binned into clusters by a compute pass
+    LightBuffer lightBuffer;
+    LightClusters lightClusters("resources/shaders/cluster_cull.comp");
+    std::vector<PointLight> scatteredLights;
+
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window)) {
@@ -512,6 +589,9 @@ int main() {
         // -----
         processInput(window);
 
+        // hand textures decoded in the background over to GL, never waits on the workers
+        textureStreamer.Update();
+
 
         // render
         // ------
@@ -519,76 +599,114 @@ int main() {
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+        // without bloom nothing reads the bright target, so the scene shaders don't write it either
+        bool bloomOutput = programState->bloom && programState->hdr;
+        glDrawBuffers(bloomOutput ? 2 : 1, attachments);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        ourShader.use();
+        uniformRing.BeginFrame();
+        FrameBlock frame = { glm::vec4(currentFrame, deltaTime, 0.0f, 0.0f),
+                             glm::vec4(SCR_WIDTH, SCR_HEIGHT, 1.0f / SCR_WIDTH, 1.0f / SCR_HEIGHT) };
+        uniformRing.Bind(FrameBlockBinding, frame);
         // view/projection transformations
+        float nearPlane = 0.1f, farPlane = 100.0f;
         glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, nearPlane, farPlane);
         glm::mat4 view = programState->camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
+        ViewBlock viewBlock = { view, projection, projection * view, glm::vec4(programState->camera.Position, 1.0f),
+                                glm::vec4(nearPlane, farPlane, 0.0f, 0.0f), glm::inverse(projection * view) };
+        uniformRing.Bind(ViewBlockBinding, viewBlock);
+
+        LodView lodView = { programState->camera.Position, projection[1][1] * SCR_HEIGHT * 0.5f, programState->lodPixelError };
 
-        ourShader.setVec3("viewPosition", programState->camera.Position);
         //Dir Light
-        ourShader.setVec3("dirLight.direction", dirLight.direction);
-        ourShader.setVec3("dirLight.ambient", dirLight.ambient);
-        ourShader.setVec3("dirLight.diffuse", dirLight.diffuse);
-        ourShader.setVec3("dirLight.specular", dirLight.specular);
+        lightBuffer.Clear();
+        lightBuffer.SetDirectional(dirLight);
 
         //Eye point light 1
         eyePointLight1.position = glm::vec3(20.0 * cos(currentFrame / 2), 10.0 * sin(currentFrame / 2), 10.0 * sin(currentFrame / 2));
-        ourShader.setVec3("eyePointLight1.position", eyePointLight1.position);
-        ourShader.setVec3("eyePointLight1.ambient", eyePointLight1.ambient);
-        ourShader.setVec3("eyePointLight1.diffuse", eyePointLight1.diffuse);
-        ourShader.setVec3("eyePointLight1.specular", eyePointLight1.specular);
-        ourShader.setFloat("eyePointLight1.constant", eyePointLight1.constant);
-        ourShader.setFloat("eyePointLight1.linear", eyePointLight1.linear);
-        ourShader.setFloat("eyePointLight1.quadratic", eyePointLight1.quadratic);
+        lightBuffer.Add(eyePointLight1);
 
         //Eye point light 2
         eyePointLight2.position = glm::vec3(-10.0 * sin(currentFrame / 2), -10.0 * sin(currentFrame / 2), -20.0 * cos(currentFrame / 2));
-        ourShader.setVec3("eyePointLight2.position", eyePointLight2.position);
-        ourShader.setVec3("eyePointLight2.ambient", eyePointLight2.ambient);
-        ourShader.setVec3("eyePointLight2.diffuse", eyePointLight2.diffuse);
-        ourShader.setVec3("eyePointLight2.specular", eyePointLight2.specular);
-        ourShader.setFloat("eyePointLight2.constant", eyePointLight2.constant);
-        ourShader.setFloat("eyePointLight2.linear", eyePointLight2.linear);
-        ourShader.setFloat("eyePointLight2.quadratic", eyePointLight2.quadratic);
+        lightBuffer.Add(eyePointLight2);
 
         //Candle point light
-        ourShader.setVec3("candlePointLight.position", candlePointLight.position);
-        ourShader.setVec3("candlePointLight.ambient", candlePointLight.ambient);
-        ourShader.setVec3("candlePointLight.diffuse", candlePointLight.diffuse);
-        ourShader.setVec3("candlePointLight.specular", candlePointLight.specular);
-        ourShader.setFloat("candlePointLight.constant", candlePointLight.constant);
-        ourShader.setFloat("candlePointLight.linear", candlePointLight.linear);
-        ourShader.setFloat("candlePointLight.quadratic", candlePointLight.quadratic);
+        lightBuffer.Add(candlePointLight);
 
         //Camera spotlight
         cameraSpotlight.position = programState->camera.Position;
         cameraSpotlight.direction = programState->camera.Front;
-        ourShader.setVec3("cameraSpotLight.position", cameraSpotlight.position);
-        ourShader.setVec3("cameraSpotLight.direction", cameraSpotlight.direction);
-        ourShader.setVec3("cameraSpotLight.ambient", cameraSpotlight.ambient);
-        ourShader.setVec3("cameraSpotLight.diffuse", cameraSpotlight.diffuse);
-        ourShader.setVec3("cameraSpotLight.specular", cameraSpotlight.specular);
-        ourShader.setFloat("cameraSpotLight.constant", cameraSpotlight.constant);
-        ourShader.setFloat("cameraSpotLight.linear", cameraSpotlight.linear);
-        ourShader.setFloat("cameraSpotLight.quadratic", cameraSpotlight.quadratic);\
-        ourShader.setFloat("cameraSpotLight.cutOff", cameraSpotlight.cutOff);
-        ourShader.setFloat("cameraSpotLight.outerCutOff", cameraSpotlight.outerCutOff);
-
-        ourShader.setBool("blinn", programState->blinn);
-        ourShader.setFloat("isCamSpotLightEnabled", programState->isCamSpotLightEnabled);
-
-        // render the island model
+        if (programState->isCamSpotLightEnabled)
+            lightBuffer.Add(cameraSpotlight);
+
+        // extra lights spread over the island, placed relative to its bounds
+        if ((int)scatteredLights.size() != programState->scatteredLightCount)
+            scatteredLights = ScatterLights(programState->scatteredLightCount);
+        glm::vec3 islandCenter = programState->islandModelPosition + islandModel.BoundsCenter() * programState->islandModelScale;
+        float islandRadius = islandModel.BoundsRadius() * programState->islandModelScale;
+        for (PointLight light : scatteredLights)
+        {
+            light.position = islandCenter + light.position * islandRadius;
+            light.quadratic /= islandRadius * islandRadius;
+            lightBuffer.Add(light);
+        }
+        lightBuffer.Upload();
+        lightClusters.Cull(projection, nearPlane, farPlane);
+
+        // the toggles select precompiled variants instead of branching per fragment. every variant one toggle
+        // away is compiled in the background, so flipping one later doesn't wait for the compiler.
+        unsigned int features = (programState->blinn ? ShaderBlinn : 0u) | (programState->isCamSpotLightEnabled ? ShaderSpotLight : 0u) |
+                                (bloomOutput ? ShaderBloomOutput : 0u) | (programState->clusterHeatmap ? ShaderClusterHeatmap : 0u);
+        forwardShaders.PrecompileNeighbours(features);
+        forwardShaders.PrecompileNeighbours(features | ShaderAlphaTest);
+        gBufferShaders.PrecompileNeighbours(features);
+        depthPrepassShaders.PrecompileNeighbours(0);
+        deferredLightingShaders.PrecompileNeighbours(features);
+
+        // forward shades while drawing; deferred only writes surface attributes here and lights them below
+        ShaderVariants &sceneShaders = programState->deferred ? gBufferShaders : forwardShaders;
+        if (programState->deferred)
+            gBuffer.Bind();
+        // the alpha test discard stays on for a model until its diffuse textures are known to have no alpha, so
+        // only cut-out textures (leaves, the flame, the lighthouse windows) keep paying for it.
+        // nothing is drawn blended, opaque items also keep the G-buffer's specular alpha from being blended.
+        Shader &opaqueShader = sceneShaders.Get(features);
+        Shader &alphaTestedShader = sceneShaders.Get(features | ShaderAlphaTest);
+        auto shaderFor = [&](Model &sceneModel) -> Shader& {
+            return sceneModel.AlphaTested() ? alphaTestedShader : opaqueShader;
+        };
+        auto pipelineFor = [](Model &sceneModel, unsigned int pipeline) {
+            return sceneModel.AlphaTested() ? pipeline | PipelineAlphaTest : pipeline;
+        };
+        // the big models, also the occluders
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model,
                                programState->islandModelPosition); // translate it down so it's at the center of the scene
         model = glm::scale(model, glm::vec3(programState->islandModelScale));    // it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", model);
-        islandModel.Draw(ourShader);
+        glm::mat4 lighthouse = glm::mat4(1.0f);
+        lighthouse = glm::translate(lighthouse, programState->lighthouseModelPosition);
+        lighthouse = glm::scale(lighthouse, glm::vec3(programState->lighthouseModelScale));
+        glm::mat4 shed = glm::mat4(1.0f);
+        shed = glm::translate(shed, programState->shedModelPosition);
+        shed = glm::scale(shed, glm::vec3(programState->shedModelScale));
+
+        // everything submitted below is tested against their depth, rasterized on the CPU
+        bool cpuOcclusion = programState->occlusionCulling && !programState->gpuCulling;
+        if (cpuOcclusion)
+        {
+            occlusionCuller.Clear(projection * view);
+            occlusionCuller.RenderOccluder(islandModel.Occluder(), model);
+            occlusionCuller.RenderOccluder(lighthouseModel.Occluder(), lighthouse);
+            occlusionCuller.RenderOccluder(shedModel.Occluder(), shed);
+            occlusionCuller.BuildHierarchy();
+        }
+        renderQueue.UseGpuCulling(programState->gpuCulling ? &gpuCuller : nullptr);
+        renderQueue.Begin(programState->camera.Position, projection * view, cpuOcclusion ? &occlusionCuller : nullptr);
+
+        // render the island model
+        islandModel.SelectLod(model, lodView);
+        renderQueue.Submit(islandModel, shaderFor(islandModel), model, pipelineFor(islandModel, PipelineOpaque));
 
         // render eye model 1
         glm::mat4 eyeball1 = glm::mat4(1.0f);
@@ -604,8 +722,6 @@ int main() {
         eyeball1 = glm::rotate(eyeball1, -yaw, glm::vec3(0.0f, 1.0f, 0.0f)); // Rotate around y-axis (yaw)
         eyeball1 = glm::rotate(eyeball1, pitch, glm::vec3(0.0f, 0.0f, 1.0f)); // Rotate around z-axis (pitch)
         eyeball1 = glm::scale(eyeball1, glm::vec3(programState->eyeModelScale));
-        ourShader.setMat4("model", eyeball1);
-        eyeModel1.Draw(ourShader);
 
         // render eye model 2
         glm::mat4 eyeball2 = glm::mat4(1.0f);
@@ -618,67 +734,94 @@ int main() {
         eyeball2 = glm::rotate(eyeball2, -yaw, glm::vec3(0.0f, 1.0f, 0.0f)); // Rotate around y-axis (yaw)
         eyeball2 = glm::rotate(eyeball2, pitch, glm::vec3(0.0f, 0.0f, 1.0f)); // Rotate around z-axis (pitch)
         eyeball2 = glm::scale(eyeball2, glm::vec3(programState->eyeModelScale));
-        ourShader.setMat4("model", eyeball2);
-        eyeModel2.Draw(ourShader);
 
-        // render the lighthouse model
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
+        glm::mat4 eyeballs[] = { eyeball1, eyeball2 };
+        eyeModel.SelectLod(eyeballs, 2, lodView);
+        renderQueue.SubmitInstanced(eyeModel, shaderFor(eyeModel), eyeballs, 2, nullptr, pipelineFor(eyeModel, PipelineOpaque));
 
-        glm::mat4 lighthouse = glm::mat4(1.0f);
-        lighthouse = glm::translate(lighthouse, programState->lighthouseModelPosition);
-        lighthouse = glm::scale(lighthouse, glm::vec3(programState->lighthouseModelScale));
-        ourShader.setMat4("model", lighthouse);
-        lighthouseModel.Draw(ourShader);
-        glDisable(GL_CULL_FACE);
+        // render the lighthouse model, a closed mesh that skips its back faces
+        lighthouseModel.SelectLod(lighthouse, lodView);
+        renderQueue.Submit(lighthouseModel, shaderFor(lighthouseModel), lighthouse, pipelineFor(lighthouseModel, PipelineCullBack));
 
         // render shed model
-        glm::mat4 shed = glm::mat4(1.0f);
-        shed = glm::translate(shed, programState->shedModelPosition);
-        shed = glm::scale(shed, glm::vec3(programState->shedModelScale));
-        ourShader.setMat4("model", shed);
-        shedModel.Draw(ourShader);
+        shedModel.SelectLod(shed, lodView);
+        renderQueue.Submit(shedModel, shaderFor(shedModel), shed, pipelineFor(shedModel, PipelineOpaque));
 
         // render picnic table model
         glm::mat4 picnicTable = glm::mat4(1.0f);
         picnicTable = glm::translate(picnicTable, programState->picnicTableModelPosition);
         picnicTable = glm::scale(picnicTable, glm::vec3(programState->picnicTableModelScale));
-        ourShader.setMat4("model", picnicTable);
-        picnicTableModel.Draw(ourShader);
+        picnicTableModel.SelectLod(picnicTable, lodView);
+        renderQueue.Submit(picnicTableModel, shaderFor(picnicTableModel), picnicTable, pipelineFor(picnicTableModel, PipelineOpaque));
 
         // render tree model
         glm::mat4 tree = glm::mat4 (1.0f);
         tree = glm::translate(tree, programState->treeModelPosition);
         tree = glm::scale(tree, glm::vec3(programState->treeModelScale));
-        ourShader.setMat4("model", tree);
-        treeModel.Draw(ourShader);
+        // the extra trees are scattered over the island, all of them one instanced submission with the tree above
+        if ((int)extraTrees.size() != programState->extraTreeCount)
+            extraTrees = ScatterTrees(programState->extraTreeCount);
+        treeTransforms.assign(1, tree);
+        treeTints.assign(1, glm::vec4(1.0f));
+        for (const TreeInstance &instance : extraTrees)
+        {
+            glm::vec3 position = islandCenter + glm::vec3(instance.position.x, 0.0f, instance.position.y) * islandRadius;
+            position.y = programState->treeModelPosition.y;
+            glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+            transform = glm::rotate(transform, instance.yaw, glm::vec3(0.0f, 1.0f, 0.0f));
+            treeTransforms.push_back(glm::scale(transform, glm::vec3(programState->treeModelScale * instance.scale)));
+            treeTints.push_back(instance.tint);
+        }
+        treeModel.SelectLod(treeTransforms.data(), treeTransforms.size(), lodView);
+        renderQueue.SubmitInstanced(treeModel, shaderFor(treeModel), treeTransforms.data(), treeTransforms.size(), treeTints.data(),
+                                    pipelineFor(treeModel, PipelineOpaque));
 
         // render round table model
         glm::mat4 roundTable = glm::mat4(1.0f);
         roundTable = glm::translate(roundTable, programState->roundTableModelPosition);
         roundTable = glm::scale(roundTable, glm::vec3(programState->roundTableModelScale));
-        ourShader.setMat4("model", roundTable);
-        roundTableModel.Draw(ourShader);
+        roundTableModel.SelectLod(roundTable, lodView);
+        renderQueue.Submit(roundTableModel, shaderFor(roundTableModel), roundTable, pipelineFor(roundTableModel, PipelineOpaque));
 
         // render candle model
         glm::mat4 candle = glm::mat4(1.0f);
         candle = glm::translate(candle, programState->candleModelPosition);
         candle = glm::scale(candle, glm::vec3(programState->candleModelScale));
-        ourShader.setMat4("model", candle);
-        candleModel.Draw(ourShader);
+        candleModel.SelectLod(candle, lodView);
+        renderQueue.Submit(candleModel, shaderFor(candleModel), candle, pipelineFor(candleModel, PipelineOpaque));
 
         // render firewood model
         glm::mat4 firewood = glm::mat4(1.0f);
         firewood = glm::translate(firewood, programState->firewoodModelPosition);
         firewood = glm::scale(firewood, glm::vec3(programState->firewoodModelScale));
-        ourShader.setMat4("model", firewood);
-        firewoodModel.Draw(ourShader);
+        firewoodModel.SelectLod(firewood, lodView);
+        renderQueue.Submit(firewoodModel, shaderFor(firewoodModel), firewood, pipelineFor(firewoodModel, PipelineOpaque));
+
+        // with the pre-pass, the opaque depth is laid down first and the scene shaders only run on what is visible.
+        // Get() never stands in a variant without ALPHA_TEST for one with it, the cut-outs' depth stays exact.
+        DepthPrepass prepass = { &depthPrepassShaders.Get(0), &depthPrepassShaders.Get(ShaderAlphaTest) };
+        unsigned int fragmentQuery = fragmentQueries[fragmentQueryFrame++ % UniformRing::FramesInFlight];
+        if (fragmentQueryFrame > UniformRing::FramesInFlight)
+            glGetQueryObjectuiv(fragmentQuery, GL_QUERY_RESULT, &fragmentInvocations);
+        renderState.ResetStats();
+        glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS, fragmentQuery);
+        renderQueue.Execute(renderState, programState->depthPrepass ? &prepass : nullptr);
+        glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS);
+        renderState.stats.fragmentInvocations = fragmentInvocations;
+
+        if (programState->deferred)
+        {
+            // the skybox still depth tests against the scene in hdrFBO
+            gBuffer.BlitDepth(hdrFBO);
+            glDisable(GL_DEPTH_TEST);
+            deferredLightingShaders.Get(features).use();
+            gBuffer.BindTextures(0);
+            renderQuad();
+            glEnable(GL_DEPTH_TEST);
+        }
 
         glDepthFunc(GL_LEQUAL);
         skyboxShader.use();
-        view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix()));
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
         // skybox cube
         glBindVertexArray(skyboxVAO);
         glActiveTexture(GL_TEXTURE0);
@@ -687,10 +830,16 @@ int main() {
         glBindVertexArray(0);
         glDepthFunc(GL_LESS); // set depth function back to default
 
+        // this frame's depth is what the next one is culled against
+        if (programState->gpuCulling)
+            hiZPyramid.Build(depthTexture, projection * view);
+        else
+            hiZPyramid.Invalidate();
+
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
         bool horizontal = true, first_iteration = true;
-        unsigned int amount = 10;
+        unsigned int amount = bloomOutput ? 10 : 0; // nothing to blur without bloom
         blurShader.use();
         for (unsigned int i = 0; i < amount; i++)
         {
@@ -715,9 +864,10 @@ int main() {
         hdrShader.setFloat("exposure", programState->exposure);
         hdrShader.setFloat("gamma", programState->gamma);
         renderQuad();
+        uniformRing.EndFrame();
 
         if (programState->ImGuiEnabled)
-            DrawImGui(programState);
+            DrawImGui(programState, sceneModels, renderState.Stats(), textureStreamer, lightClusters);
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
@@ -725,15 +875,47 @@ int main() {
         glfwPollEvents();
     }
 
-    programState->SaveToFile("resources/program_state.txt");
-    delete programState;
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
-    // glfw: terminate, clearing all previously allocated GLFW resources.
-    // ------------------------------------------------------------------
-    glfwTerminate();
-    return 0;
+    glDeleteQueries(UniformRing::FramesInFlight, fragmentQueries);
+}
+
+// 'count' coloured point lights in island space: positions on a disc of radius 1, a little above the centre,
+// with a range of 0.05. the caller scales positions by the island's radius and the quadratic term by 1 / radius^2.
+std::vector<PointLight> ScatterLights(int count)
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<PointLight> lights(count);
+    for (PointLight &light : lights)
+    {
+        float angle = unit(random) * 6.2831853f, distance = std::sqrt(unit(random));
+        light.position = glm::vec3(std::cos(angle) * distance, unit(random) * 0.1f, std::sin(angle) * distance);
+        glm::vec3 color = glm::vec3(unit(random), unit(random), unit(random));
+        light.diffuse = color / std::max(color.r, std::max(color.g, color.b));
+        light.specular = light.diffuse * 0.5f;
+        light.ambient = glm::vec3(0.0f);
+        const float range = 0.05f;
+        light.constant = 1.0f;
+        light.linear = 0.0f;
+        light.quadratic = (1.0f / LightCutoff - 1.0f) / (range * range);
+    }
+    return lights;
+}
+
+std::vector<TreeInstance> ScatterTrees(int count)
+{
+    std::mt19937 random(2);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<TreeInstance> trees(count);
+    for (TreeInstance &tree : trees)
+    {
+        // inside 80% of the island's radius, so few of them stand in the water
+        float angle = unit(random) * 6.2831853f, distance = std::sqrt(unit(random)) * 0.8f;
+        tree.position = glm::vec2(std::cos(angle), std::sin(angle)) * distance;
+        tree.yaw = unit(random) * 6.2831853f;
+        tree.scale = 0.7f + unit(random) * 0.6f;
+        tree.tint = glm::vec4(0.85f + unit(random) * 0.3f, 0.85f + unit(random) * 0.3f, 0.85f + unit(random) * 0.15f, 1.0f);
+    }
+    return trees;
 }
 
 unsigned int quadVAO = 0;
@@ -765,37 +947,6 @@ void renderQuad()
     glBindVertexArray(0);
 }
 
-// Load skybox texture
-unsigned int loadCubemap(vector<std::string> faces)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
-}
-
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow *window) {
@@ -845,7 +996,8 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
     programState->camera.ProcessMouseScroll(yoffset);
 }
 //TO DO: Tidy up gui
-void DrawImGui(ProgramState *programState) {
+void DrawImGui(ProgramState *programState, const std::vector<std::pair<const char*, const Model*>> &models, const RenderStats &renderStats,
+               const TextureStreamer &textureStreamer, const LightClusters &lightClusters) {
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -857,6 +1009,7 @@ void DrawImGui(ProgramState *programState) {
         ImGui::Begin("Controls");
         ImGui::Text(programState->hdr ? "HDR ON" : "HDR OFF");
         ImGui::Text(programState->bloom && programState->hdr ? "Bloom ON" : "Bloom OFF");
+        ImGui::Text(programState->deferred ? "Deferred shading" : "Forward shading");
         if(ImGui::CollapsingHeader("HDR"))
         {
             ImGui::DragFloat("Exposure", (float *) &programState->exposure, 0.005f, 0.1f, 1.0f);
@@ -1013,9 +1166,61 @@ void DrawImGui(ProgramState *programState) {
             }
         }
 
+        if(ImGui::CollapsingHeader("Level of detail"))
+        {
+            ImGui::DragFloat("Pixel error", &programState->lodPixelError, 0.05f, 0.1f, 20.0f);
+            for (const auto &model : models)
+                ImGui::BulletText("%s: LOD %u/%u, %u triangles", model.first, model.second->ActiveLod(),
+                                  model.second->LodCount() - 1, model.second->TriangleCount());
+        }
+
+        if(ImGui::CollapsingHeader("Rendering"))
+        {
+            ImGui::SliderInt("Extra trees", &programState->extraTreeCount, 0, 5000);
+            ImGui::Checkbox("GPU culling", &programState->gpuCulling);
+            if (programState->gpuCulling)
+            {
+                // the culling results stay on the GPU, nothing is read back to count them
+                ImGui::BulletText("Draw calls: %u for up to %u meshes", renderStats.draws, renderStats.meshes);
+                ImGui::BulletText("Objects: %u submitted, culled on the GPU", renderStats.objects);
+            }
+            else
+            {
+                ImGui::BulletText("Draw calls: %u for %u meshes", renderStats.draws, renderStats.meshes);
+                ImGui::BulletText("Objects: %u visible, %u culled", renderStats.objects, renderStats.culledObjects);
+                ImGui::Checkbox("Occlusion culling", &programState->occlusionCulling);
+                ImGui::BulletText("Objects occluded: %u", renderStats.occludedObjects);
+                ImGui::BulletText("Meshes culled: %u", renderStats.culledMeshes);
+                ImGui::BulletText("Meshlets culled: %u off screen, %u back facing, of %u", renderStats.culledMeshlets,
+                                  renderStats.backfacingMeshlets, renderStats.meshlets);
+                ImGui::BulletText("Meshlet triangles: %u of %u culled (%.0f%%)", renderStats.culledMeshletTriangles, renderStats.meshletTriangles,
+                                  renderStats.meshletTriangles ? 100.0f * renderStats.culledMeshletTriangles / renderStats.meshletTriangles : 0.0f);
+            }
+            ImGui::Checkbox("Depth pre-pass", &programState->depthPrepass);
+            if (programState->depthPrepass)
+                ImGui::BulletText("Pre-pass draw calls: %u", renderStats.prepassDraws);
+            // counted a few frames late; includes the pre-pass' own invocations, which only the alpha tested do work in
+            ImGui::BulletText("Fragment shader invocations: %u (%.2f per pixel)", renderStats.fragmentInvocations,
+                              (float)renderStats.fragmentInvocations / (SCR_WIDTH * SCR_HEIGHT));
+            ImGui::BulletText("State changes: %u", renderStats.stateChanges);
+            ImGui::BulletText("Skipped state changes: %u", renderStats.skippedChanges);
+        }
+
+        if(ImGui::CollapsingHeader("Textures"))
+        {
+            ImGui::BulletText(textureStreamer.Idle() ? "All textures loaded" : "Streaming textures");
+            ImGui::BulletText("Compressed: %.1f MB (%.1f MB as RGBA8)", textureStreamer.CompressedBytes() / (1024.0f * 1024.0f),
+                              textureStreamer.UncompressedBytes() / (1024.0f * 1024.0f));
+        }
+
         if(ImGui::CollapsingHeader("Lights"))
         {
             ImGui::BulletText(programState->blinn ? "Blinn" : "Phong");
+            ImGui::SliderInt("Scattered lights", &programState->scatteredLightCount, 0, 1024);
+            ImGui::Checkbox("Cluster heatmap", &programState->clusterHeatmap);
+            // lights past MaxLightsPerCluster are left out of a cluster's lighting, the heatmap shows those clusters in magenta
+            ImGui::BulletText("Dropped cluster lights: %u in %u clusters", lightClusters.DroppedLights(), lightClusters.OverflowClusters());
+            ImGui::Checkbox("Deferred shading", &programState->deferred);
             if(ImGui::TreeNode("Eyeball 1 Point Light"))
             {
                 if(ImGui::TreeNode("ADS"))
@@ -1132,4 +1337,6 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
         programState->hdr = !programState->hdr;
     if(key == GLFW_KEY_B && action == GLFW_PRESS)
         programState->bloom = !programState->bloom;
+    if(key == GLFW_KEY_G && action == GLFW_PRESS)
+        programState->deferred = !programState->deferred;
 }
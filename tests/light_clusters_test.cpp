@@ -0,0 +1,76 @@
+// headless test of the cluster AABBs: random points of the view frustum have to lie inside the AABB of the
+// cluster the fragment shader would look them up in
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/light_clusters.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+static int failures = 0;
+
+static void check(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        std::printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+// the same lookup as ClusterIndex() in clustered_lighting.glsl, from NDC x/y and view depth
+static unsigned int clusterFor(float ndcX, float ndcY, float depth, float zNear, float zFar)
+{
+    unsigned int slice = (unsigned int)std::max(std::log(depth / zNear) / std::log(zFar / zNear) * LightClusters::GridZ, 0.0f);
+    unsigned int tileX = std::min((unsigned int)((ndcX * 0.5f + 0.5f) * LightClusters::GridX), LightClusters::GridX - 1);
+    unsigned int tileY = std::min((unsigned int)((ndcY * 0.5f + 0.5f) * LightClusters::GridY), LightClusters::GridY - 1);
+    slice = std::min(slice, LightClusters::GridZ - 1);
+    return tileX + tileY * LightClusters::GridX + slice * LightClusters::GridX * LightClusters::GridY;
+}
+
+int main()
+{
+    const float zNear = 0.1f, zFar = 100.0f;
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1280.0f / 720.0f, zNear, zFar);
+    glm::mat4 inverseProjection = glm::inverse(projection);
+    std::vector<glm::vec4> aabbs = LightClusters::BuildAabbs(projection, zNear, zFar);
+    check(aabbs.size() == LightClusters::ClusterCount * 2, "one min and max per cluster");
+    check(std::abs(LightClusters::SliceDepth(0, zNear, zFar) - zNear) < 1e-5f, "the first slice starts at the near plane");
+    check(std::abs(LightClusters::SliceDepth(LightClusters::GridZ, zNear, zFar) - zFar) < 1e-2f, "the last slice ends at the far plane");
+
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    unsigned int outside = 0;
+    for (int i = 0; i < 200000; i++)
+    {
+        float ndcX = unit(random) * 2.0f - 1.0f, ndcY = unit(random) * 2.0f - 1.0f;
+        float depth = zNear * std::pow(zFar / zNear, unit(random));
+        glm::vec4 onNear = inverseProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+        glm::vec3 point = glm::vec3(onNear) / onNear.w;
+        point *= depth / -point.z;
+
+        unsigned int cluster = clusterFor(ndcX, ndcY, depth, zNear, zFar);
+        glm::vec3 minimum(aabbs[cluster * 2]), maximum(aabbs[cluster * 2 + 1]);
+        // float slack relative to the box, the slice boundaries go through pow and log
+        glm::vec3 slack = glm::max(glm::abs(minimum), glm::abs(maximum)) * 1e-4f;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (point[axis] < minimum[axis] - slack[axis] || point[axis] > maximum[axis] + slack[axis])
+            {
+                outside++;
+                break;
+            }
+        }
+    }
+    if (outside)
+        std::printf("%u of 200000 points outside their cluster\n", outside);
+    check(outside == 0, "every point lies inside the AABB of its cluster");
+
+    if (failures == 0)
+        std::printf("light clusters: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,59 @@
+// headless test of the software occlusion rasterizer: a wall hides a box behind it but not one in front of it
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/occlusion_culler.h>
+
+#include <cstdio>
+
+static int failures = 0;
+
+static void check(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        std::printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+static Bounds cube(const glm::vec3 &center, float halfSize)
+{
+    Bounds box;
+    box.Add(center - glm::vec3(halfSize));
+    box.Add(center + glm::vec3(halfSize));
+    return box;
+}
+
+int main()
+{
+    // camera at the origin looking down -z, a 6x6 wall 5 units away
+    glm::mat4 viewProjection = glm::perspective(glm::radians(90.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    OccluderProxy wall;
+    wall.positions = { { -3.0f, -3.0f, -5.0f }, { 3.0f, -3.0f, -5.0f }, { 3.0f, 3.0f, -5.0f }, { -3.0f, 3.0f, -5.0f } };
+    wall.indices = { 0, 1, 2, 0, 2, 3 };
+    const glm::mat4 identity(1.0f);
+
+    OcclusionCuller culler;
+    culler.Clear(viewProjection);
+    culler.RenderOccluder(wall, identity);
+    culler.BuildHierarchy();
+    check(culler.RasterizedTriangles() == 2, "both wall triangles are rasterized");
+    check(!culler.Visible(cube(glm::vec3(0.0f, 0.0f, -10.0f), 1.0f), identity), "a box behind the wall is culled");
+    check(culler.Visible(cube(glm::vec3(0.0f, 0.0f, -3.0f), 0.5f), identity), "a box in front of the wall stays visible");
+    check(culler.Visible(cube(glm::vec3(0.0f, 0.0f, -5.0f), 1.0f), identity), "a box through the wall stays visible");
+    check(culler.Visible(cube(glm::vec3(8.0f, 0.0f, -10.0f), 1.0f), identity), "a box beside the wall stays visible");
+    check(culler.Visible(cube(glm::vec3(0.0f, 0.0f, 0.0f), 1.0f), identity), "a box around the camera stays visible");
+
+    // occluders are drawn from both sides
+    wall.indices = { 0, 2, 1, 0, 3, 2 };
+    culler.Clear(viewProjection);
+    culler.RenderOccluder(wall, identity);
+    culler.BuildHierarchy();
+    check(!culler.Visible(cube(glm::vec3(0.0f, 0.0f, -10.0f), 1.0f), identity), "a clockwise wall hides the box too");
+
+    if (failures == 0)
+        std::printf("occlusion culler: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}